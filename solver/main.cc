@@ -1,7 +1,14 @@
 #include "stt_data.hh"
 #include "stt_helpers.hh"
+#include "stt_runners.hh"
 #include <easylocal.hh>
 #include <array>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <thread>
 
 //2-stages SA:
 
@@ -12,6 +19,153 @@
 using namespace EasyLocal::Core;
 using namespace EasyLocal::Debug;
 
+// the string as the content of a json string
+static string JsonEscape(const string& text)
+{
+  string escaped;
+  for (char c : text)
+    if (c == '"' || c == '\\')
+      escaped += string("\\") + c;
+    else if (c == '\n')
+      escaped += "\\n";
+    else
+      escaped += c;
+  return escaped;
+}
+
+// the options of main that the inputs, the solution managers and the runners of a run are built with
+struct STT_RunOptions
+{
+  int hard_weight, phased_weight, hard_weight_1, phased_weight_1;
+  bool only_hard_in_stage1, exit_at_zero_hard_stage1, mix_phase_during_search, mix_initial_phase, display_OF, vizing_greedy;
+  array<int, N_CONSTRAINTS> hw_array;
+  double violation_guided_rate;
+  unsigned replicas;
+  bool random_state, adaptive_rates;
+  unsigned long int stagnation_evaluations;
+  bool stagnation_restart;
+  unsigned perturbation_moves, max_stagnation_periods;
+};
+
+// the settings of a run that depend on its instance (the max_evaluations of the stages not used by the method are 0)
+struct STT_RunSettings
+{
+  int hard_weight_1_2, phased_weight_1_2;
+  unsigned long int max_evaluations_0, max_evaluations_1, max_evaluations_1_2, max_evaluations_2;
+  array<double, 6> rates;
+};
+
+// the stages of a run: the inputs (views on the shared instance), the solution managers and the runners of this module,
+// which all draw from the generator of the run, so that runs in different threads share nothing but the instance
+struct STT_Run
+{
+  STT_Run(shared_ptr<const STT_Instance> instance, int seed, const STT_RunOptions& o, const STT_RunSettings& settings)
+    : instance(instance), seed(seed), settings(settings), rng(seed),
+      in0(instance, o.hard_weight, o.phased_weight, false, o.mix_phase_during_search, false, false, o.hw_array),  //all constraints, I DON'T forbid hard worsening moves (for SA unique stage)
+      in1(instance, o.hard_weight_1, o.phased_weight_1, o.only_hard_in_stage1, o.mix_phase_during_search, false, o.exit_at_zero_hard_stage1, o.hw_array),  //only hard, I don't forbid hard worsening moves
+      in1_2(instance, settings.hard_weight_1_2, settings.phased_weight_1_2, false, o.mix_phase_during_search, false, false, o.hw_array),  //only hard, I don't forbid hard worsening moves
+      in2(instance, o.hard_weight, o.phased_weight, false, in1.phased ? false : o.mix_phase_during_search, true, false, o.hw_array),  //all constraints, I forbid hard worsening moves
+      sm0(in0, rng, "STT_SolutionManager_0", in0.phased ? false : o.mix_initial_phase, o.display_OF, o.vizing_greedy),
+      sm1(in1, rng, "STT_SolutionManager_1", in1.phased ? false : o.mix_initial_phase, o.display_OF, o.vizing_greedy),
+      sm1_2(in1_2, rng, "STT_SolutionManager_1_2", in1_2.phased ? false : o.mix_initial_phase, o.display_OF, o.vizing_greedy),
+      sm2(in2, rng, "STT_SolutionManager_2", in2.phased ? false : o.mix_initial_phase, o.display_OF, o.vizing_greedy),
+      PT_0(in0, sm0, rng, settings.rates, o.replicas, o.random_state), PT_1(in1, sm1, rng, settings.rates, o.replicas, o.random_state),
+      PT_1_2(in1_2, sm1_2, rng, settings.rates, o.replicas), PT_2(in2, sm2, rng, settings.rates, o.replicas),
+      SA_0(in0, sm0, rng, settings.rates, o.random_state), SA_1(in1, sm1, rng, settings.rates, o.random_state),
+      SA_1_2(in1_2, sm1_2, rng, settings.rates), SA_2(in2, sm2, rng, settings.rates)
+  {
+    in0.violation_guided_rate = in1.violation_guided_rate = in1_2.violation_guided_rate = in2.violation_guided_rate = o.violation_guided_rate;
+    for (STT_Runner* runner : {static_cast<STT_Runner*>(&PT_0), static_cast<STT_Runner*>(&PT_1), static_cast<STT_Runner*>(&PT_1_2), static_cast<STT_Runner*>(&PT_2),
+                               static_cast<STT_Runner*>(&SA_0), static_cast<STT_Runner*>(&SA_1), static_cast<STT_Runner*>(&SA_1_2), static_cast<STT_Runner*>(&SA_2)})
+      runner->SetAdaptiveRates(o.adaptive_rates);
+    for (STT_SimulatedAnnealing* sa : {&SA_0, &SA_1, &SA_1_2, &SA_2})
+      sa->SetStagnation(o.stagnation_evaluations, o.stagnation_restart, o.perturbation_moves, o.max_stagnation_periods);
+  }
+  shared_ptr<const STT_Instance> instance;
+  int seed;
+  STT_RunSettings settings;
+  STT_Random rng;
+  STT_Input in0, in1, in1_2, in2;
+  STT_SolutionManager sm0, sm1, sm1_2, sm2;
+  //Parallel Tempering (used in place of the solvers if replicas > 1)
+  STT_ParallelTempering PT_0, PT_1, PT_1_2, PT_2;
+  //Simulated Annealing of this module (used in place of the solvers if replicas = 1 and bounded_evaluation, time_limit, adaptive_rates, stagnation
+  //control or threads > 1 are set, which the EasyLocal runners do not support): it draws the random number of the acceptance test first and stops
+  //the evaluation of a move as soon as it is surely rejected
+  STT_SimulatedAnnealing SA_0, SA_1, SA_1_2, SA_2;
+};
+
+// what a run reports: its json fields (without braces) and the costs and the time in them
+struct STT_RunResult
+{
+  bool completed = false;
+  string failure; //what stopped the run, if not completed
+  int cost = 0, hard_cost = 0;
+  double time = 0.0;
+  string json;
+};
+
+// an instance of a batch: the instance is nullptr if it could not be parsed (and it is not solved)
+struct STT_BatchInstance
+{
+  string path;
+  shared_ptr<const STT_Instance> instance;
+  string error; //error of the parse
+  unsigned constraints = 0;
+};
+
+// the instances (*.xml) of the directory, sorted by path
+static vector<STT_BatchInstance> ParseInstances(const string& directory)
+{
+  vector<STT_BatchInstance> instances;
+  for (const auto& entry : filesystem::directory_iterator(directory))
+    if (entry.path().extension() == ".xml")
+    {
+      instances.emplace_back();
+      instances.back().path = entry.path().string();
+      try
+      {
+        instances.back().instance = make_shared<const STT_Instance>(instances.back().path);
+        for (unsigned c_type = CA1; c_type <= SE1; c_type++)
+          instances.back().constraints += instances.back().instance->ConstraintsVectorSize(c_type);
+      }
+      catch (exception& e)
+      {
+        instances.back().error = e.what();
+        if (instances.back().error.empty())
+          instances.back().error = "cannot parse the instance";
+      }
+    }
+  sort(instances.begin(), instances.end(), [](const STT_BatchInstance& i1, const STT_BatchInstance& i2) { return i1.path < i2.path; });
+  return instances;
+}
+
+// the json of a batch: for each instance, the json of its run, or the error of the parse or of the run
+static void PrintBatch(const vector<STT_BatchInstance>& instances, const vector<STT_RunResult>& results)
+{
+  long long total_cost = 0;
+  unsigned solved = 0, feasible = 0;
+  cout << "{\"instances\": [";
+  for (unsigned i = 0; i < instances.size(); i++)
+  {
+    cout << (i > 0 ? ", " : "") << "{\"instance\": \"" << JsonEscape(instances[i].path) << "\", \"constraints\":" << instances[i].constraints;
+    if (!instances[i].instance)
+      cout << ", \"error\": \"" << JsonEscape(instances[i].error) << "\"";
+    else if (results[i].completed)
+    {
+      cout << ", \"result\": {" << results[i].json << "}";
+      total_cost += results[i].cost;
+      solved++;
+      if (results[i].hard_cost == 0)
+        feasible++;
+    }
+    else
+      cout << ", \"failed\": \"" << JsonEscape(results[i].failure.empty() ? "unknown exception" : results[i].failure) << "\"";
+    cout << "}";
+  }
+  cout << "], \"solved\":" << solved << ", \"feasible\":" << feasible << ", \"total_cost\":" << total_cost << "}" << endl;
+}
+
 int main(int argc, const char* argv[]) {
 
     ParameterBox main_parameters("main", "Main Program options");
@@ -21,8 +175,12 @@ int main(int argc, const char* argv[]) {
     ParameterBox STAGE2_parameters("STAGE2", "Simulated Annealing options - Stage 2");
     ParameterBox NH_parameters("NH", "Neighborhoods options");
     ParameterBox HW_parameters("HW", "Hard Components Weights");
+    ParameterBox PT_parameters("PT", "Parallel Tempering, in place of the Simulated Annealing of each stage if replicas > 1");
+    ParameterBox SO_parameters("SO", "Strategic Oscillation of the hard weights (method ESA-SO)");
+    ParameterBox STAGNATION_parameters("STAGNATION", "Stagnation control of the Simulated Annealing of each stage (not with the Parallel Tempering)");
 
     Parameter<string> instance("instance", "Input instance", main_parameters);
+    Parameter<string> instance_dir("instance_dir", "Solve all the instances (*.xml) of the directory, --main::threads at a time, and print a single json with the results of all (in place of --main::instance)", main_parameters);
     Parameter<long int> seed("seed", "Random seed", main_parameters);
     Parameter<string> method("method", "Solution method (empty for tester)", main_parameters);
     Parameter<string> init_state("init_state", "Initial state (to be read from file)", main_parameters);
@@ -33,6 +191,7 @@ int main(int argc, const char* argv[]) {
     Parameter<bool> mix_phase_during_search("mix_phase_during_search", "Mix Phase during search, default=true", main_parameters);
     Parameter<bool> display_OF("DisplayObjFunc", "display obj function decrease", main_parameters);
     Parameter<int> test_stage("test_stage", "activate tester for stage 1 or 2", main_parameters);
+    Parameter<unsigned> check_moves("check_moves", "With test_stage, check non-interactively the delta costs of this number of random moves of each neighborhood against the full recalculation (exit status 1 on a mismatch), default: 0 (interactive tester)", main_parameters);
     Parameter<bool> use_hard_coded_parameters("use_hcp", "Use Hard Coded Parameters, NOTE: will ignore any other command line parameter, default: false", main_parameters);
     Parameter<bool> verbose_mode("verbose_mode", "Activate Verbose Mode, NOTE: not compatible with Json2Run, default: false", main_parameters);
     Parameter<double> correlation_factor("correlation_factor", "In ESA-3S Multilplies obtains hard weight multipling this factor per the number of hard constraints", main_parameters);
@@ -41,6 +200,9 @@ int main(int argc, const char* argv[]) {
     Parameter<string> start_type("start_type", "possible valuses: random, greedy or vizing. default: random (ignored if use_hard_coded_parameters is active)", main_parameters);
     Parameter<bool> j2rmode("j2rmode", "if true, prints the output on a single line. Default: false", main_parameters);
     Parameter<bool> print_full_solution("print_full_solution", "if true, prints the full solutions at the end. Ignored if verbose_mode is active. Default: true", main_parameters);
+    Parameter<int> threads("threads", "Number of independent runs in parallel (with seeds seed, seed+1, ...), only the best one is printed. Default: 1", main_parameters);
+    Parameter<double> time_limit("time_limit", "Wall-clock time budget in seconds, shared among the stages proportionally to their max_evaluations; the temperature follows the elapsed time (if not set, the stages stop at max_evaluations)", main_parameters);
+    Parameter<bool> bounded_evaluation("bounded_evaluation", "Run the stages with the Simulated Annealing of stt_runners, which stops the evaluation of a move as soon as it is surely rejected, in place of the one of EasyLocal (always with time_limit, adaptive_rates, stagnation control, ESA-SO and threads > 1), default: false", main_parameters);
 
 
     Parameter<double> swap_teams_rate("swap_teams_rate", "Probability of move swap_teams", NH_parameters);
@@ -54,6 +216,8 @@ int main(int argc, const char* argv[]) {
     Parameter<double> swap_round_swap_homes_rate("swap_round_swap_homes_rate", "Probability of move swap_round_swap_homes_rate", NH_parameters);
     Parameter<double> swap_matches_notphased_rate_swap_matchround_rate("swap_matches_notphased_rate_swap_matchround_rate", "Probability of move swap_matches_notphased_rate_swap_matchround", NH_parameters);
     Parameter<double> swap_matches_phased_rate_swap_matchround_rate("swap_matches_phased_rate_swap_matchround_rate", "Probability of move swap_matches_phased_rate_swap_matchround", NH_parameters);
+    Parameter<bool> adaptive_rates("adaptive_rates", "Adapt online the probabilities of the moves to their decrease of the cost per constraint evaluated (sliding window bandit), default: false", NH_parameters);
+    Parameter<double> violation_guided_rate("violation_guided_rate", "Probability that a random move starts from a team and a round of a violated constraint, default: 0", NH_parameters);
 
     Parameter<double> start_temperature_0("start_temperature", "Full Simulated Annealing start_temperature", SA_parameters);
     Parameter<double> cooling_rate_0("cooling_rate", "Full Simulated Annealing cooling_rate", SA_parameters);
@@ -90,6 +254,21 @@ int main(int argc, const char* argv[]) {
     Parameter<int> hw_fa2("FA2", "FA2 Weight", HW_parameters);
     Parameter<int> hw_se1("SE1", "SE1 Weight", HW_parameters);
 
+    //parallel tempering: the temperatures range between expected_min_temperature and start_temperature of the stage, and each replica makes max_evaluations
+    Parameter<int> replicas("replicas", "Number of replicas (one thread each), default: 1 (Simulated Annealing)", PT_parameters);
+    Parameter<unsigned long int> swap_interval("swap_interval", "Evaluations of each replica between two exchanges, default: 10000", PT_parameters);
+
+    //strategic oscillation: a single Simulated Annealing with all the constraints (as ESA-0) whose hard weights are changed during the search
+    Parameter<unsigned long int> oscillation_interval("interval", "Evaluations between two changes of the hard weights, default: 10000", SO_parameters);
+    Parameter<unsigned> feasible_window("feasible_window", "Consecutive feasible checks before the hard weights are halved, default: 10", SO_parameters);
+    Parameter<int> max_factor("max_factor", "Maximum factor of the hard weight of a type (the global one ranges up to hard_weight/max_factor), default: 8", SO_parameters);
+
+    //stagnation control: a reheat or a restart after evaluations without improvements, and the stop of the stage after max_periods of them in a row
+    Parameter<unsigned long int> stagnation_evaluations("evaluations", "Evaluations without improvements of the best solution that trigger a reheat or a restart, default: 0 (no control)", STAGNATION_parameters);
+    Parameter<string> stagnation_action("action", "possible values: reheat (the temperature goes back to the one of half of the schedule done) or restart (from the best solution perturbed), default: reheat", STAGNATION_parameters);
+    Parameter<unsigned> perturbation_moves("perturbation", "Random moves applied to the best solution at a restart, default: 10", STAGNATION_parameters);
+    Parameter<unsigned> max_stagnation_periods("max_periods", "Stagnation periods in a row without improvements that stop the stage, default: 0 (never)", STAGNATION_parameters);
+
     swap_teams_rate = 0.1;
     swap_rounds_rate = 0.1;
     swap_matches_notphased_rate = 0.2;
@@ -101,6 +280,8 @@ int main(int argc, const char* argv[]) {
     swap_round_swap_homes_rate = 0.0;
     swap_matches_phased_rate_swap_matchround_rate = 0.0;
     swap_matches_notphased_rate_swap_matchround_rate = 0.0;
+    violation_guided_rate = 0.0;
+    adaptive_rates = false;
     mix_initial_phase = true; //default value
     mix_phase_during_search = true; //default value
     use_hard_coded_parameters = false; //default value
@@ -111,6 +292,17 @@ int main(int argc, const char* argv[]) {
     start_type = "random";
     j2rmode = false;
     print_full_solution = true;
+    threads = 1;
+    bounded_evaluation = false;
+    replicas = 1;
+    swap_interval = 10000;
+    oscillation_interval = 10000;
+    feasible_window = 10;
+    max_factor = 8;
+    stagnation_evaluations = 0;
+    stagnation_action = "reheat";
+    perturbation_moves = 10;
+    max_stagnation_periods = 0;
 
     //HARD WEIGHTS
     hw_ca1 = 1;
@@ -147,6 +339,11 @@ int main(int argc, const char* argv[]) {
       if(static_cast<string>(start_type) == "vizing")
         vizing_greedy = true;
     }
+    if(static_cast<string>(stagnation_action) != "reheat" && static_cast<string>(stagnation_action) != "restart")
+    {
+      cout << "Incorrect value for --STAGNATION::action, please select one of the following (with no capital letters): [reheat, restart]" << endl;
+      exit(1);
+    }
 
     if(use_hard_coded_parameters)
     {
@@ -206,7 +403,7 @@ int main(int argc, const char* argv[]) {
         hard_weight_1_2 = 40;
         phased_weight_1_2 = 400;
       }
-      else if(method == "ESA-0")
+      else if(method == "ESA-0" || method == "ESA-SO")
       {
         hard_weight = 40;
         phased_weight = 400;
@@ -215,14 +412,49 @@ int main(int argc, const char* argv[]) {
       correlation_factor = 0.5;
     }
 
-    if (!instance.IsSet())
+    if (!instance.IsSet() && !instance_dir.IsSet())
     {
-        cout << "Error: --main::instance filename option must always be set" << endl;
+        cout << "Error: --main::instance filename option must always be set (or --main::instance_dir for a batch)" << endl;
         return 1;
     }  
+    if (instance_dir.IsSet() && (!method.IsSet() || output_file.IsSet()))
+    {
+        cout << "Error: --main::instance_dir requires --main::method and is not supported with --main::output_file" << endl;
+        return 1;
+    }
+    // checked before any run starts, so that a wrong option is reported once
+    if (time_limit.IsSet() && time_limit <= 0.0)
+    {
+        cout << "Error: --main::time_limit must be positive" << endl;
+        return 1;
+    }
+    if (method.IsSet() && method == string("ESA-SO") && replicas > 1)
+    {
+        cout << "Error: method ESA-SO is not supported with --PT::replicas greater than 1" << endl;
+        return 1;
+    }
+    if (stagnation_evaluations > 0 && replicas > 1)
+    {
+        cout << "Error: --STAGNATION::evaluations is not supported with --PT::replicas greater than 1" << endl;
+        return 1;
+    }
+    if (method.IsSet() && method != string("ESA-0") && method != string("ESA-SO") && method != string("ESA-3S") && method != string("ESA-2S") && method != string("ESA-2S-OH"))
+    {
+        cout << "Error: unknown --main::method " << string(method) << ", please select one of the following: [ESA-0, ESA-SO, ESA-2S, ESA-2S-OH, ESA-3S]" << endl;
+        return 1;
+    }
+    if (threads < 1)
+    {
+        cout << "Error: --main::threads must be at least 1" << endl;
+        return 1;
+    }
+    if (threads > 1 && !instance_dir.IsSet() && output_file.IsSet())
+    {
+        cout << "Error: --main::output_file is not supported with --main::threads greater than 1" << endl;
+        return 1;
+    }
     if (seed.IsSet())
         Random::SetSeed(seed);
-    
     array<int, N_CONSTRAINTS> hw_array = {hw_ca1, hw_ca2, hw_ca3, hw_ca4, hw_ga1, hw_br1, hw_br2, hw_fa2, hw_se1};
     
     bool only_hard_in_stage1 = true; //ESA-2S-OH e ESA-3S
@@ -234,41 +466,139 @@ int main(int argc, const char* argv[]) {
       exit_at_zero_hard_stage1 = false;
     }
 
-    STT_Input in0(instance, hard_weight, phased_weight, false, mix_phase_during_search, false, false, hw_array);  //all constraints, I DON'T forbid hard worsening moves (for SA unique stage)
-    
-    //unsigned n_constraints = in0.constraints_CA1.size() + in0.constraints_CA2.size() + in0.constraints_CA3.size() + in0.constraints_CA4.size() + in0.constraints_GA1.size() + in0.constraints_BR1.size() + in0.constraints_BR2.size() + in0.constraints_FA2.size() + in0.constraints_SE1.size();
-    unsigned n_hard_n_constraints = in0.constraints_hard_indexes[CA1].size() + in0.constraints_hard_indexes[CA2].size() + in0.constraints_hard_indexes[CA3].size() + in0.constraints_hard_indexes[CA4].size() + in0.constraints_hard_indexes[GA1].size() + in0.constraints_hard_indexes[BR1].size() + in0.constraints_hard_indexes[BR2].size() + in0.constraints_hard_indexes[FA2].size() + in0.constraints_hard_indexes[SE1].size();
-    
-    STT_Input in1(instance, hard_weight_1, phased_weight_1, only_hard_in_stage1, mix_phase_during_search, false, exit_at_zero_hard_stage1, hw_array);  //only hard, I don't forbid hard worsening moves
-    
-    if(use_hard_coded_parameters && correlate_with_n_hard_constraints)
+    // the instance is parsed once and shared by the inputs of all the stages, which differ only for their configuration
+    // (in a batch, the run of main is built on the first instance parsed, and each instance gets its own run)
+    shared_ptr<const STT_Instance> stt_instance;
+    vector<STT_BatchInstance> batch;
+    if (instance_dir.IsSet())
     {
-      hard_weight_1_2 = static_cast<int>(n_hard_n_constraints*correlation_factor);
-      phased_weight_1_2 = 10*hard_weight_1_2;
+      batch = ParseInstances(instance_dir);
+      auto parsed = find_if(batch.begin(), batch.end(), [](const STT_BatchInstance& i) { return i.instance != nullptr; });
+      if (parsed == batch.end())
+      {
+        PrintBatch(batch, vector<STT_RunResult>(batch.size()));
+        return 0;
+      }
+      stt_instance = parsed->instance;
     }
-    
-    STT_Input in1_2(instance, hard_weight_1_2, phased_weight_1_2, false, mix_phase_during_search, false, false, hw_array);  //only hard, I don't forbid hard worsening moves
-    STT_Input in2(instance, hard_weight, phased_weight, false, in1.phased ? false : mix_phase_during_search, true, false, hw_array);  //all constraints, I forbid hard worsening moves
-    
-    if(use_hard_coded_parameters && !max_evaluations_1.IsSet() && !max_evaluations_2.IsSet() && !max_evaluations_1_2.IsSet())
-    {
-      //per farla durare circa un'ora applichiamo la formula sottostante,
-      // pilotando il primo numero cambia il tempo concesso 
-      //double expected_duration = 0.05; //expected duration in hours
-      //max_evaluations_0 = static_cast<long unsigned int>(expected_duration*20000000000/n_constraints);
-      //la lunghezza dello stage 1 dipenderà dalla complessità dell'istanza
-      if(in1.phased && n_hard_n_constraints >= 200)  //in questo caso 500 mln
+    else
+      stt_instance = make_shared<const STT_Instance>(string(instance));
+
+    // the settings that depend on the instance are computed without changing the options, so that each instance of a
+    // batch gets the ones of a run on it alone
+    auto run_settings = [&](const STT_Instance& stt) {
+      STT_RunSettings settings;
+      //unsigned n_constraints = in0.constraints_CA1.size() + in0.constraints_CA2.size() + in0.constraints_CA3.size() + in0.constraints_CA4.size() + in0.constraints_GA1.size() + in0.constraints_BR1.size() + in0.constraints_BR2.size() + in0.constraints_FA2.size() + in0.constraints_SE1.size();
+      unsigned n_hard_n_constraints = 0;
+      for (unsigned c_type = CA1; c_type <= SE1; c_type++)
+        n_hard_n_constraints += stt.constraints_hard_indexes[c_type].size();
+
+      settings.hard_weight_1_2 = hard_weight_1_2;
+      settings.phased_weight_1_2 = phased_weight_1_2;
+      if(use_hard_coded_parameters && correlate_with_n_hard_constraints)
       {
-        max_evaluations_1 = 500000000;  //5000000 for races, 500000000 for batches
-        max_evaluations_1_2 = 50000000; //500000 for races, 50000000 for batches
+        settings.hard_weight_1_2 = static_cast<int>(n_hard_n_constraints*correlation_factor);
+        settings.phased_weight_1_2 = 10*settings.hard_weight_1_2;
+      }
+
+      string m = method.IsSet() ? string(method) : "";
+      settings.max_evaluations_0 = m == "ESA-0" || m == "ESA-SO" || m == "ESA-2S" ? static_cast<unsigned long int>(max_evaluations_0) : 0;
+      if(use_hard_coded_parameters && !max_evaluations_1.IsSet() && !max_evaluations_2.IsSet() && !max_evaluations_1_2.IsSet())
+      {
+        //per farla durare circa un'ora applichiamo la formula sottostante,
+        // pilotando il primo numero cambia il tempo concesso 
+        //double expected_duration = 0.05; //expected duration in hours
+        //max_evaluations_0 = static_cast<long unsigned int>(expected_duration*20000000000/n_constraints);
+        //la lunghezza dello stage 1 dipenderà dalla complessità dell'istanza
+        if(stt.phased && n_hard_n_constraints >= 200)  //in questo caso 500 mln
+        {
+          settings.max_evaluations_1 = 500000000;  //5000000 for races, 500000000 for batches
+          settings.max_evaluations_1_2 = 50000000; //500000 for races, 50000000 for batches
+        }
+        else
+        {
+          settings.max_evaluations_1 = 20000000;   //200000 for races, 20000000 for batches
+          settings.max_evaluations_1_2 = 250000000; //2500000 for races, 250000000 for batches 
+        }     
+        settings.max_evaluations_2 = 40000;   //0 for races, 40000 for batches
       }
       else
       {
-        max_evaluations_1 = 20000000;   //200000 for races, 20000000 for batches
-        max_evaluations_1_2 = 250000000; //2500000 for races, 250000000 for batches 
-      }     
-      max_evaluations_2 = 40000;   //0 for races, 40000 for batches
-    }
+        settings.max_evaluations_1 = m == "ESA-2S-OH" || m == "ESA-3S" ? static_cast<unsigned long int>(max_evaluations_1) : 0;
+        settings.max_evaluations_1_2 = m == "ESA-3S" ? static_cast<unsigned long int>(max_evaluations_1_2) : 0;
+        settings.max_evaluations_2 = m == "ESA-2S" || m == "ESA-2S-OH" || m == "ESA-3S" ? static_cast<unsigned long int>(max_evaluations_2) : 0;
+      }
+
+      //PROBABILITIES
+      double teams, rounds, matches_notphased, matches_phased, matchround;
+      if (use_hard_coded_parameters || !swap_teams_rate.IsSet() || !swap_rounds_rate.IsSet() || !swap_matches_phased_rate.IsSet() || !swap_matches_notphased_rate.IsSet() || !swap_matchround_rate.IsSet())
+      { // insert rates based on the feature "phased"
+        if(!stt.phased)
+        {
+           if(disable_pswtp)
+           {
+              teams = 0.08;
+              rounds = 0.03;
+              matches_notphased = 0.34;
+              matches_phased = 0.00;
+              matchround = 0.38;
+           }
+           else
+           {
+              teams = 0.07;
+              rounds = 0.025;
+              matches_notphased = 0.319;
+              matches_phased = 0.07;
+              matchround = 0.35;
+           }
+            
+        }
+        else
+        {      
+            if(disable_pswtp)
+            {
+              teams = 0.02;
+              rounds = 0.09;
+              matches_notphased = 0.14;
+              matches_phased = 0.00;
+              matchround = 0.60;
+            }
+            else
+            {
+              teams = 0.02;
+              rounds = 0.08;
+              matches_notphased = 0.12; 
+              matches_phased = 0.13;
+              matchround = 0.52;
+            }
+            
+        }
+      }
+      else
+      {
+        teams = swap_teams_rate;
+        rounds = swap_rounds_rate;
+        matches_notphased = swap_matches_notphased_rate;
+        matches_phased = swap_matches_phased_rate;
+        matchround = swap_matchround_rate;
+      }
+      settings.rates = {max(0.0, 1.0 - teams - rounds - matches_notphased - matches_phased - matchround), teams, rounds, matches_notphased, matches_phased, matchround};
+      return settings;
+    };
+
+    STT_RunOptions run_options{hard_weight, phased_weight, hard_weight_1, phased_weight_1, only_hard_in_stage1, exit_at_zero_hard_stage1,
+                               mix_phase_during_search, mix_initial_phase, display_OF, vizing_greedy, hw_array, violation_guided_rate,
+                               static_cast<unsigned>(static_cast<int>(replicas)), !use_hard_coded_parameters && static_cast<string>(start_type) == "random", adaptive_rates,
+                               stagnation_evaluations, static_cast<string>(stagnation_action) == "restart", perturbation_moves, max_stagnation_periods};
+
+    // the run of main, whose stages are also the ones of the EasyLocal solvers and of the testers: our components draw
+    // from its generator, the EasyLocal runners from Random, both seeded by seed
+    STT_Run main_run(stt_instance, Random::GetSeed(), run_options, run_settings(*stt_instance));
+    STT_Random& rng = main_run.rng;
+    STT_Input& in0 = main_run.in0;
+    STT_Input& in1 = main_run.in1;
+    STT_Input& in1_2 = main_run.in1_2;
+    STT_Input& in2 = main_run.in2;
 
     if(!in1.phased && mix_phase_during_search == false)
     {
@@ -283,10 +613,10 @@ int main(int argc, const char* argv[]) {
     }
 
     //should start now implementation of costs: hard and soft
-    STT_SolutionManager sm0(in0, "STT_SolutionManager_0", in0.phased ? false : mix_initial_phase, display_OF, vizing_greedy);
-    STT_SolutionManager sm1(in1, "STT_SolutionManager_1", in1.phased ? false : mix_initial_phase, display_OF, vizing_greedy);
-    STT_SolutionManager sm1_2(in1_2, "STT_SolutionManager_1_2", in1_2.phased ? false : mix_initial_phase, display_OF, vizing_greedy);
-    STT_SolutionManager sm2(in2, "STT_SolutionManager_2", in2.phased ? false : mix_initial_phase, display_OF, vizing_greedy);    
+    STT_SolutionManager& sm0 = main_run.sm0;
+    STT_SolutionManager& sm1 = main_run.sm1;
+    STT_SolutionManager& sm1_2 = main_run.sm1_2;
+    STT_SolutionManager& sm2 = main_run.sm2;
 
     //aggiungo i costi a sm0
     CA1CostComponent ca1_0(in0, 1, false, "CA1_0");
@@ -390,419 +720,111 @@ int main(int argc, const char* argv[]) {
     }
 
     //Creo i NH per il SA a unico stage
-    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh0(in0, sm0);
-    STT_swap_homes_nh0.AddCostComponent(ca1_0);
-    STT_swap_homes_nh0.AddCostComponent(ca2_0);
-    STT_swap_homes_nh0.AddCostComponent(ca3_0);
-    STT_swap_homes_nh0.AddCostComponent(ca4_0);
-    STT_swap_homes_nh0.AddCostComponent(ga1_0);
-    STT_swap_homes_nh0.AddCostComponent(br1_0);
-    STT_swap_homes_nh0.AddCostComponent(br2_0);
-    STT_swap_homes_nh0.AddCostComponent(fa2_0);
-    STT_swap_homes_nh0.AddCostComponent(se1_0);
-    if(in0.phased)
-    {
-      STT_swap_homes_nh0.AddCostComponent(phs_0);
-    }
+    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh0(in0, sm0, rng);
+    STT_DeltaCostComponents<STT_SwapHomes> STT_swap_homes_dcc0(in0, "swap_homes_0", ca1_0, ca2_0, ca3_0, ca4_0, ga1_0, br1_0, br2_0, fa2_0, se1_0, phs_0);
+    STT_swap_homes_dcc0.AddTo(STT_swap_homes_nh0);
 
-    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh0(in0, sm0);
-    STT_swap_teams_nh0.AddCostComponent(ca1_0);
-    STT_swap_teams_nh0.AddCostComponent(ca2_0);
-    STT_swap_teams_nh0.AddCostComponent(ca3_0);
-    STT_swap_teams_nh0.AddCostComponent(ca4_0);
-    STT_swap_teams_nh0.AddCostComponent(ga1_0);
-    STT_swap_teams_nh0.AddCostComponent(br1_0);
-    STT_swap_teams_nh0.AddCostComponent(br2_0);
-    STT_swap_teams_nh0.AddCostComponent(fa2_0);
-    STT_swap_teams_nh0.AddCostComponent(se1_0);
-    if(in0.phased)
-    {
-      STT_swap_teams_nh0.AddCostComponent(phs_0);
-    }
+    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh0(in0, sm0, rng);
+    STT_DeltaCostComponents<STT_SwapTeams> STT_swap_teams_dcc0(in0, "swap_teams_0", ca1_0, ca2_0, ca3_0, ca4_0, ga1_0, br1_0, br2_0, fa2_0, se1_0, phs_0);
+    STT_swap_teams_dcc0.AddTo(STT_swap_teams_nh0);
 
-    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh0(in0, sm0);
-    STT_swap_rounds_nh0.AddCostComponent(ca1_0);
-    STT_swap_rounds_nh0.AddCostComponent(ca2_0);
-    STT_swap_rounds_nh0.AddCostComponent(ca3_0);
-    STT_swap_rounds_nh0.AddCostComponent(ca4_0);
-    STT_swap_rounds_nh0.AddCostComponent(ga1_0);
-    STT_swap_rounds_nh0.AddCostComponent(br1_0);
-    STT_swap_rounds_nh0.AddCostComponent(br2_0);
-    STT_swap_rounds_nh0.AddCostComponent(fa2_0);
-    STT_swap_rounds_nh0.AddCostComponent(se1_0);
-    if(in0.phased)
-    {
-      STT_swap_rounds_nh0.AddCostComponent(phs_0);
-    }
+    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh0(in0, sm0, rng);
+    STT_DeltaCostComponents<STT_SwapRounds> STT_swap_rounds_dcc0(in0, "swap_rounds_0", ca1_0, ca2_0, ca3_0, ca4_0, ga1_0, br1_0, br2_0, fa2_0, se1_0, phs_0);
+    STT_swap_rounds_dcc0.AddTo(STT_swap_rounds_nh0);
 
 
-    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh0(in0, sm0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(ca1_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(ca2_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(ca3_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(ca4_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(ga1_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(br1_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(br2_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(fa2_0);
-    STT_swap_matches_notphased_nh0.AddCostComponent(se1_0);
-    if(in0.phased)
-    {
-      STT_swap_matches_notphased_nh0.AddCostComponent(phs_0);
-    }
+    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh0(in0, sm0, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesNotPhased> STT_swap_matches_notphased_dcc0(in0, "swap_matches_notphased_0", ca1_0, ca2_0, ca3_0, ca4_0, ga1_0, br1_0, br2_0, fa2_0, se1_0, phs_0);
+    STT_swap_matches_notphased_dcc0.AddTo(STT_swap_matches_notphased_nh0);
 
-    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh0(in0, sm0);
-    STT_swap_matches_phased_nh0.AddCostComponent(ca1_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(ca2_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(ca3_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(ca4_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(ga1_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(br1_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(br2_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(fa2_0);
-    STT_swap_matches_phased_nh0.AddCostComponent(se1_0);
-    if(in0.phased)
-    {
-      STT_swap_matches_phased_nh0.AddCostComponent(phs_0);
-    }
+    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh0(in0, sm0, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesPhased> STT_swap_matches_phased_dcc0(in0, "swap_matches_phased_0", ca1_0, ca2_0, ca3_0, ca4_0, ga1_0, br1_0, br2_0, fa2_0, se1_0, phs_0);
+    STT_swap_matches_phased_dcc0.AddTo(STT_swap_matches_phased_nh0);
 
-    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh0(in0, sm0);
-    STT_swap_match_round_nh0.AddCostComponent(ca1_0);
-    STT_swap_match_round_nh0.AddCostComponent(ca2_0);
-    STT_swap_match_round_nh0.AddCostComponent(ca3_0);
-    STT_swap_match_round_nh0.AddCostComponent(ca4_0);
-    STT_swap_match_round_nh0.AddCostComponent(ga1_0);
-    STT_swap_match_round_nh0.AddCostComponent(br1_0);
-    STT_swap_match_round_nh0.AddCostComponent(br2_0);
-    STT_swap_match_round_nh0.AddCostComponent(fa2_0);
-    STT_swap_match_round_nh0.AddCostComponent(se1_0);
-    if(in0.phased)
-    {
-      STT_swap_match_round_nh0.AddCostComponent(phs_0);
-    }
+    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh0(in0, sm0, rng);
+    STT_DeltaCostComponents<STT_SwapMatchRound> STT_swap_match_round_dcc0(in0, "swap_match_round_0", ca1_0, ca2_0, ca3_0, ca4_0, ga1_0, br1_0, br2_0, fa2_0, se1_0, phs_0);
+    STT_swap_match_round_dcc0.AddTo(STT_swap_match_round_nh0);
     
     //Creo i NH per il il primo stage
-    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh1(in1, sm1);
-    STT_swap_homes_nh1.AddCostComponent(ca1_1);
-    STT_swap_homes_nh1.AddCostComponent(ca2_1);
-    STT_swap_homes_nh1.AddCostComponent(ca3_1);
-    STT_swap_homes_nh1.AddCostComponent(ca4_1);
-    STT_swap_homes_nh1.AddCostComponent(ga1_1);
-    STT_swap_homes_nh1.AddCostComponent(br1_1);
-    STT_swap_homes_nh1.AddCostComponent(br2_1);
-    STT_swap_homes_nh1.AddCostComponent(fa2_1);
-    STT_swap_homes_nh1.AddCostComponent(se1_1);
-    if(in1.phased)
-    {
-      STT_swap_homes_nh1.AddCostComponent(phs_1);
-    }
+    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh1(in1, sm1, rng);
+    STT_DeltaCostComponents<STT_SwapHomes> STT_swap_homes_dcc1(in1, "swap_homes_1", ca1_1, ca2_1, ca3_1, ca4_1, ga1_1, br1_1, br2_1, fa2_1, se1_1, phs_1);
+    STT_swap_homes_dcc1.AddTo(STT_swap_homes_nh1);
 
-    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh1(in1, sm1);
-    STT_swap_teams_nh1.AddCostComponent(ca1_1);
-    STT_swap_teams_nh1.AddCostComponent(ca2_1);
-    STT_swap_teams_nh1.AddCostComponent(ca3_1);
-    STT_swap_teams_nh1.AddCostComponent(ca4_1);
-    STT_swap_teams_nh1.AddCostComponent(ga1_1);
-    STT_swap_teams_nh1.AddCostComponent(br1_1);
-    STT_swap_teams_nh1.AddCostComponent(br2_1);
-    STT_swap_teams_nh1.AddCostComponent(fa2_1);
-    STT_swap_teams_nh1.AddCostComponent(se1_1);
-    if(in1.phased)
-    {
-      STT_swap_teams_nh1.AddCostComponent(phs_1);
-    }
+    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh1(in1, sm1, rng);
+    STT_DeltaCostComponents<STT_SwapTeams> STT_swap_teams_dcc1(in1, "swap_teams_1", ca1_1, ca2_1, ca3_1, ca4_1, ga1_1, br1_1, br2_1, fa2_1, se1_1, phs_1);
+    STT_swap_teams_dcc1.AddTo(STT_swap_teams_nh1);
 
-    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh1(in1, sm1);
-    STT_swap_rounds_nh1.AddCostComponent(ca1_1);
-    STT_swap_rounds_nh1.AddCostComponent(ca2_1);
-    STT_swap_rounds_nh1.AddCostComponent(ca3_1);
-    STT_swap_rounds_nh1.AddCostComponent(ca4_1);
-    STT_swap_rounds_nh1.AddCostComponent(ga1_1);
-    STT_swap_rounds_nh1.AddCostComponent(br1_1);
-    STT_swap_rounds_nh1.AddCostComponent(br2_1);
-    STT_swap_rounds_nh1.AddCostComponent(fa2_1);
-    STT_swap_rounds_nh1.AddCostComponent(se1_1);
-    if(in1.phased)
-    {
-      STT_swap_rounds_nh1.AddCostComponent(phs_1);
-    }
+    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh1(in1, sm1, rng);
+    STT_DeltaCostComponents<STT_SwapRounds> STT_swap_rounds_dcc1(in1, "swap_rounds_1", ca1_1, ca2_1, ca3_1, ca4_1, ga1_1, br1_1, br2_1, fa2_1, se1_1, phs_1);
+    STT_swap_rounds_dcc1.AddTo(STT_swap_rounds_nh1);
 
 
-    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh1(in1, sm1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(ca1_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(ca2_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(ca3_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(ca4_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(ga1_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(br1_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(br2_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(fa2_1);
-    STT_swap_matches_notphased_nh1.AddCostComponent(se1_1);
-    if(in1.phased)
-    {
-      STT_swap_matches_notphased_nh1.AddCostComponent(phs_1);
-    }
+    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh1(in1, sm1, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesNotPhased> STT_swap_matches_notphased_dcc1(in1, "swap_matches_notphased_1", ca1_1, ca2_1, ca3_1, ca4_1, ga1_1, br1_1, br2_1, fa2_1, se1_1, phs_1);
+    STT_swap_matches_notphased_dcc1.AddTo(STT_swap_matches_notphased_nh1);
 
-    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh1(in1, sm1);
-    STT_swap_matches_phased_nh1.AddCostComponent(ca1_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(ca2_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(ca3_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(ca4_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(ga1_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(br1_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(br2_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(fa2_1);
-    STT_swap_matches_phased_nh1.AddCostComponent(se1_1);
-    if(in1.phased)
-    {
-      STT_swap_matches_phased_nh1.AddCostComponent(phs_1);
-    }
+    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh1(in1, sm1, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesPhased> STT_swap_matches_phased_dcc1(in1, "swap_matches_phased_1", ca1_1, ca2_1, ca3_1, ca4_1, ga1_1, br1_1, br2_1, fa2_1, se1_1, phs_1);
+    STT_swap_matches_phased_dcc1.AddTo(STT_swap_matches_phased_nh1);
 
-    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh1(in1, sm1);
-    STT_swap_match_round_nh1.AddCostComponent(ca1_1);
-    STT_swap_match_round_nh1.AddCostComponent(ca2_1);
-    STT_swap_match_round_nh1.AddCostComponent(ca3_1);
-    STT_swap_match_round_nh1.AddCostComponent(ca4_1);
-    STT_swap_match_round_nh1.AddCostComponent(ga1_1);
-    STT_swap_match_round_nh1.AddCostComponent(br1_1);
-    STT_swap_match_round_nh1.AddCostComponent(br2_1);
-    STT_swap_match_round_nh1.AddCostComponent(fa2_1);
-    STT_swap_match_round_nh1.AddCostComponent(se1_1);
-    if(in1.phased)
-    {
-      STT_swap_match_round_nh1.AddCostComponent(phs_1);
-    }
+    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh1(in1, sm1, rng);
+    STT_DeltaCostComponents<STT_SwapMatchRound> STT_swap_match_round_dcc1(in1, "swap_match_round_1", ca1_1, ca2_1, ca3_1, ca4_1, ga1_1, br1_1, br2_1, fa2_1, se1_1, phs_1);
+    STT_swap_match_round_dcc1.AddTo(STT_swap_match_round_nh1);
 
     //Stage 1_2
     //Creo i NH per il il primo stage
-    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh1_2(in1_2, sm1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(ca1_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(ca2_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(ca3_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(ca4_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(ga1_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(br1_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(br2_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(fa2_1_2);
-    STT_swap_homes_nh1_2.AddCostComponent(se1_1_2);
-    if(in1_2.phased)
-    {
-      STT_swap_homes_nh1_2.AddCostComponent(phs_1_2);
-    }
+    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh1_2(in1_2, sm1_2, rng);
+    STT_DeltaCostComponents<STT_SwapHomes> STT_swap_homes_dcc1_2(in1_2, "swap_homes_1_2", ca1_1_2, ca2_1_2, ca3_1_2, ca4_1_2, ga1_1_2, br1_1_2, br2_1_2, fa2_1_2, se1_1_2, phs_1_2);
+    STT_swap_homes_dcc1_2.AddTo(STT_swap_homes_nh1_2);
 
-    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh1_2(in1_2, sm1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(ca1_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(ca2_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(ca3_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(ca4_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(ga1_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(br1_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(br2_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(fa2_1_2);
-    STT_swap_teams_nh1_2.AddCostComponent(se1_1_2);
-    if(in1_2.phased)
-    {
-      STT_swap_teams_nh1_2.AddCostComponent(phs_1_2);
-    }
+    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh1_2(in1_2, sm1_2, rng);
+    STT_DeltaCostComponents<STT_SwapTeams> STT_swap_teams_dcc1_2(in1_2, "swap_teams_1_2", ca1_1_2, ca2_1_2, ca3_1_2, ca4_1_2, ga1_1_2, br1_1_2, br2_1_2, fa2_1_2, se1_1_2, phs_1_2);
+    STT_swap_teams_dcc1_2.AddTo(STT_swap_teams_nh1_2);
 
-    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh1_2(in1_2, sm1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(ca1_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(ca2_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(ca3_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(ca4_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(ga1_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(br1_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(br2_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(fa2_1_2);
-    STT_swap_rounds_nh1_2.AddCostComponent(se1_1_2);
-    if(in1_2.phased)
-    {
-      STT_swap_rounds_nh1_2.AddCostComponent(phs_1_2);
-    }
+    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh1_2(in1_2, sm1_2, rng);
+    STT_DeltaCostComponents<STT_SwapRounds> STT_swap_rounds_dcc1_2(in1_2, "swap_rounds_1_2", ca1_1_2, ca2_1_2, ca3_1_2, ca4_1_2, ga1_1_2, br1_1_2, br2_1_2, fa2_1_2, se1_1_2, phs_1_2);
+    STT_swap_rounds_dcc1_2.AddTo(STT_swap_rounds_nh1_2);
 
 
-    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh1_2(in1_2, sm1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(ca1_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(ca2_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(ca3_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(ca4_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(ga1_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(br1_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(br2_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(fa2_1_2);
-    STT_swap_matches_notphased_nh1_2.AddCostComponent(se1_1_2);
-    if(in1_2.phased)
-    {
-      STT_swap_matches_notphased_nh1_2.AddCostComponent(phs_1_2);
-    }
+    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh1_2(in1_2, sm1_2, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesNotPhased> STT_swap_matches_notphased_dcc1_2(in1_2, "swap_matches_notphased_1_2", ca1_1_2, ca2_1_2, ca3_1_2, ca4_1_2, ga1_1_2, br1_1_2, br2_1_2, fa2_1_2, se1_1_2, phs_1_2);
+    STT_swap_matches_notphased_dcc1_2.AddTo(STT_swap_matches_notphased_nh1_2);
 
-    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh1_2(in1_2, sm1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(ca1_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(ca2_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(ca3_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(ca4_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(ga1_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(br1_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(br2_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(fa2_1_2);
-    STT_swap_matches_phased_nh1_2.AddCostComponent(se1_1_2);
-    if(in1_2.phased)
-    {
-      STT_swap_matches_phased_nh1_2.AddCostComponent(phs_1_2);
-    }
+    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh1_2(in1_2, sm1_2, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesPhased> STT_swap_matches_phased_dcc1_2(in1_2, "swap_matches_phased_1_2", ca1_1_2, ca2_1_2, ca3_1_2, ca4_1_2, ga1_1_2, br1_1_2, br2_1_2, fa2_1_2, se1_1_2, phs_1_2);
+    STT_swap_matches_phased_dcc1_2.AddTo(STT_swap_matches_phased_nh1_2);
 
-    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh1_2(in1_2, sm1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(ca1_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(ca2_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(ca3_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(ca4_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(ga1_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(br1_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(br2_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(fa2_1_2);
-    STT_swap_match_round_nh1_2.AddCostComponent(se1_1_2);
-    if(in1_2.phased)
-    {
-      STT_swap_match_round_nh1_2.AddCostComponent(phs_1_2);
-    }
+    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh1_2(in1_2, sm1_2, rng);
+    STT_DeltaCostComponents<STT_SwapMatchRound> STT_swap_match_round_dcc1_2(in1_2, "swap_match_round_1_2", ca1_1_2, ca2_1_2, ca3_1_2, ca4_1_2, ga1_1_2, br1_1_2, br2_1_2, fa2_1_2, se1_1_2, phs_1_2);
+    STT_swap_match_round_dcc1_2.AddTo(STT_swap_match_round_nh1_2);
 
     //Creo i NH per il secondo stage
-    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh2(in2, sm2);
-    STT_swap_homes_nh2.AddCostComponent(ca1_2);
-    STT_swap_homes_nh2.AddCostComponent(ca2_2);
-    STT_swap_homes_nh2.AddCostComponent(ca3_2);
-    STT_swap_homes_nh2.AddCostComponent(ca4_2);
-    STT_swap_homes_nh2.AddCostComponent(ga1_2);
-    STT_swap_homes_nh2.AddCostComponent(br1_2);
-    STT_swap_homes_nh2.AddCostComponent(br2_2);
-    STT_swap_homes_nh2.AddCostComponent(fa2_2);
-    STT_swap_homes_nh2.AddCostComponent(se1_2);
-    if(in2.phased)
-    {
-      STT_swap_homes_nh2.AddCostComponent(phs_2);
-    }
+    STT_SwapHomesNeighborhoodExplorer STT_swap_homes_nh2(in2, sm2, rng);
+    STT_DeltaCostComponents<STT_SwapHomes> STT_swap_homes_dcc2(in2, "swap_homes_2", ca1_2, ca2_2, ca3_2, ca4_2, ga1_2, br1_2, br2_2, fa2_2, se1_2, phs_2);
+    STT_swap_homes_dcc2.AddTo(STT_swap_homes_nh2);
 
-    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh2(in2, sm2);
-    STT_swap_teams_nh2.AddCostComponent(ca1_2);
-    STT_swap_teams_nh2.AddCostComponent(ca2_2);
-    STT_swap_teams_nh2.AddCostComponent(ca3_2);
-    STT_swap_teams_nh2.AddCostComponent(ca4_2);
-    STT_swap_teams_nh2.AddCostComponent(ga1_2);
-    STT_swap_teams_nh2.AddCostComponent(br1_2);
-    STT_swap_teams_nh2.AddCostComponent(br2_2);
-    STT_swap_teams_nh2.AddCostComponent(fa2_2);
-    STT_swap_teams_nh2.AddCostComponent(se1_2);
-    if(in2.phased)
-    {
-      STT_swap_teams_nh2.AddCostComponent(phs_2);
-    }
+    STT_SwapTeamsNeighborhoodExplorer STT_swap_teams_nh2(in2, sm2, rng);
+    STT_DeltaCostComponents<STT_SwapTeams> STT_swap_teams_dcc2(in2, "swap_teams_2", ca1_2, ca2_2, ca3_2, ca4_2, ga1_2, br1_2, br2_2, fa2_2, se1_2, phs_2);
+    STT_swap_teams_dcc2.AddTo(STT_swap_teams_nh2);
 
-    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh2(in2, sm2);
-    STT_swap_rounds_nh2.AddCostComponent(ca1_2);
-    STT_swap_rounds_nh2.AddCostComponent(ca2_2);
-    STT_swap_rounds_nh2.AddCostComponent(ca3_2);
-    STT_swap_rounds_nh2.AddCostComponent(ca4_2);
-    STT_swap_rounds_nh2.AddCostComponent(ga1_2);
-    STT_swap_rounds_nh2.AddCostComponent(br1_2);
-    STT_swap_rounds_nh2.AddCostComponent(br2_2);
-    STT_swap_rounds_nh2.AddCostComponent(fa2_2);
-    STT_swap_rounds_nh2.AddCostComponent(se1_2);
-    if(in2.phased)
-    {
-      STT_swap_rounds_nh2.AddCostComponent(phs_2);
-    }
+    STT_SwapRoundsNeighborhoodExplorer STT_swap_rounds_nh2(in2, sm2, rng);
+    STT_DeltaCostComponents<STT_SwapRounds> STT_swap_rounds_dcc2(in2, "swap_rounds_2", ca1_2, ca2_2, ca3_2, ca4_2, ga1_2, br1_2, br2_2, fa2_2, se1_2, phs_2);
+    STT_swap_rounds_dcc2.AddTo(STT_swap_rounds_nh2);
 
 
-    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh2(in2, sm2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(ca1_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(ca2_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(ca3_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(ca4_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(ga1_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(br1_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(br2_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(fa2_2);
-    STT_swap_matches_notphased_nh2.AddCostComponent(se1_2);
-    if(in2.phased)
-    {
-      STT_swap_matches_notphased_nh2.AddCostComponent(phs_2);
-    }
+    STT_SwapMatchesNotPhasedNeighborhoodExplorer STT_swap_matches_notphased_nh2(in2, sm2, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesNotPhased> STT_swap_matches_notphased_dcc2(in2, "swap_matches_notphased_2", ca1_2, ca2_2, ca3_2, ca4_2, ga1_2, br1_2, br2_2, fa2_2, se1_2, phs_2);
+    STT_swap_matches_notphased_dcc2.AddTo(STT_swap_matches_notphased_nh2);
 
-    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh2(in2, sm2);
-    STT_swap_matches_phased_nh2.AddCostComponent(ca1_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(ca2_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(ca3_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(ca4_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(ga1_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(br1_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(br2_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(fa2_2);
-    STT_swap_matches_phased_nh2.AddCostComponent(se1_2);
-    if(in2.phased)
-    {
-      STT_swap_matches_phased_nh2.AddCostComponent(phs_2);
-    }
+    STT_SwapMatchesPhasedNeighborhoodExplorer STT_swap_matches_phased_nh2(in2, sm2, rng);
+    STT_DeltaCostComponents<STT_SwapMatchesPhased> STT_swap_matches_phased_dcc2(in2, "swap_matches_phased_2", ca1_2, ca2_2, ca3_2, ca4_2, ga1_2, br1_2, br2_2, fa2_2, se1_2, phs_2);
+    STT_swap_matches_phased_dcc2.AddTo(STT_swap_matches_phased_nh2);
 
-    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh2(in2, sm2);
-    STT_swap_match_round_nh2.AddCostComponent(ca1_2);
-    STT_swap_match_round_nh2.AddCostComponent(ca2_2);
-    STT_swap_match_round_nh2.AddCostComponent(ca3_2);
-    STT_swap_match_round_nh2.AddCostComponent(ca4_2);
-    STT_swap_match_round_nh2.AddCostComponent(ga1_2);
-    STT_swap_match_round_nh2.AddCostComponent(br1_2);
-    STT_swap_match_round_nh2.AddCostComponent(br2_2);
-    STT_swap_match_round_nh2.AddCostComponent(fa2_2);
-    STT_swap_match_round_nh2.AddCostComponent(se1_2);
-    if(in2.phased)
-    {
-      STT_swap_match_round_nh2.AddCostComponent(phs_2);
-    }
+    STT_SwapMatchRoundNeighborhoodExplorer STT_swap_match_round_nh2(in2, sm2, rng);
+    STT_DeltaCostComponents<STT_SwapMatchRound> STT_swap_match_round_dcc2(in2, "swap_match_round_2", ca1_2, ca2_2, ca3_2, ca4_2, ga1_2, br1_2, br2_2, fa2_2, se1_2, phs_2);
+    STT_swap_match_round_dcc2.AddTo(STT_swap_match_round_nh2);
 
-    //PROBABILITIES
-    if (use_hard_coded_parameters || !swap_teams_rate.IsSet() || !swap_rounds_rate.IsSet() || !swap_matches_phased_rate.IsSet() || !swap_matches_notphased_rate.IsSet() || !swap_matchround_rate.IsSet())
-    { // insert rates based on the feature "phased"
-      if(!in1.phased)
-      {
-         if(disable_pswtp)
-         {
-            swap_teams_rate = 0.08;
-            swap_rounds_rate = 0.03;
-            swap_matches_notphased_rate = 0.34;
-            swap_matches_phased_rate = 0.00;
-            swap_matchround_rate = 0.38;
-         }
-         else
-         {
-            swap_teams_rate = 0.07;
-            swap_rounds_rate = 0.025;
-            swap_matches_notphased_rate = 0.319;
-            swap_matches_phased_rate = 0.07;
-            swap_matchround_rate = 0.35;
-         }
-          
-      }
-      else
-      {      
-          if(disable_pswtp)
-          {
-            swap_teams_rate = 0.02;
-            swap_rounds_rate = 0.09;
-            swap_matches_notphased_rate = 0.14;
-            swap_matches_phased_rate = 0.00;
-            swap_matchround_rate = 0.60;
-          }
-          else
-          {
-            swap_teams_rate = 0.02;
-            swap_rounds_rate = 0.08;
-            swap_matches_notphased_rate = 0.12; 
-            swap_matches_phased_rate = 0.13;
-            swap_matchround_rate = 0.52;
-          }
-          
-      }
-    }      
-    array<double, 6> rates_6{max(0.0, 1.0 - swap_teams_rate - swap_rounds_rate - swap_matches_notphased_rate - swap_matches_phased_rate - swap_matchround_rate), swap_teams_rate, swap_rounds_rate, swap_matches_notphased_rate, swap_matches_phased_rate, swap_matchround_rate};
+    const array<double, 6>& rates_6 = main_run.settings.rates;
 
     //ESAMODAL Unique Stage
     SetUnionNeighborhoodExplorer<STT_Input, STT_Solution, DefaultCostStructure<int>, 
@@ -909,7 +931,38 @@ int main(int argc, const char* argv[]) {
       return 1;
 
   //for testing purposes
-  if (test_stage.IsSet())
+  if (test_stage.IsSet() && check_moves > 0)
+  {
+    // the moves of each neighborhood are made in turn on the same solution, from init_state or a random state
+    auto check = [&](const STT_Input& in, STT_SolutionManager& sm, const auto&... nes) {
+      STT_Solution st(in);
+      if (init_state.IsSet())
+      {
+        ifstream is(static_cast<string>(init_state));
+        is >> st;
+      }
+      else
+        sm.RandomState(st);
+      unsigned mismatches = 0;
+      ((mismatches += STT_CheckDeltaCosts(nes, st, check_moves, cout)), ...);
+      return mismatches;
+    };
+    unsigned mismatches;
+    if (static_cast<int>(test_stage) == 0)
+      mismatches = check(in0, sm0, STT_swap_homes_nh0, STT_swap_teams_nh0, STT_swap_rounds_nh0, STT_swap_matches_notphased_nh0, STT_swap_matches_phased_nh0, STT_swap_match_round_nh0);
+    else if (static_cast<int>(test_stage) == 1)
+      mismatches = check(in1, sm1, STT_swap_homes_nh1, STT_swap_teams_nh1, STT_swap_rounds_nh1, STT_swap_matches_notphased_nh1, STT_swap_matches_phased_nh1, STT_swap_match_round_nh1);
+    else if (static_cast<int>(test_stage) == 2)
+      mismatches = check(in2, sm2, STT_swap_homes_nh2, STT_swap_teams_nh2, STT_swap_rounds_nh2, STT_swap_matches_notphased_nh2, STT_swap_matches_phased_nh2, STT_swap_match_round_nh2);
+    else
+    {
+      cout << "test_stage must be 0 (for unique SA), 1 or 2" << endl;
+      return 0;
+    }
+    cout << "Delta costs checked on " << check_moves << " random moves of each neighborhood: " << mismatches << " mismatches" << endl;
+    return mismatches > 0 ? 1 : 0;
+  }
+  else if (test_stage.IsSet())
   { 
     if (static_cast<int>(test_stage) == 0)
     {
@@ -943,329 +996,492 @@ int main(int argc, const char* argv[]) {
   }   //Simulated Annealing algorithm for optimization
   else 
   {
-    int cost;
-    double time;
-
-    STT_Solution out0(in0, display_OF);
-    out0.SetPrintSolutionOneLine(j2rmode);
-    SolverResult<STT_Input, STT_Solution> result0(out0);
-
-    if (method.IsSet() && method == string("ESA-0")) //ESA-0 = Esamodal Simulated Annealing - Single Stage
-    {
-      STT_ESA_0.SetParameter("start_temperature", static_cast<double>(start_temperature_0));
-      STT_ESA_0.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_0));
-      STT_ESA_0.SetParameter("cooling_rate", static_cast<double>(cooling_rate_0));
-      STT_ESA_0.SetParameter("max_evaluations", static_cast<unsigned long int>(max_evaluations_0));
-      STT_ESA_0.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_0));
-      STT_solver_0.SetRunner(STT_ESA_0);
-
-      if(init_state.IsSet())
-      {
-        ifstream is(static_cast<string>(init_state));
-        STT_Solution out_warmstart(in0, display_OF);
-        //out_warmstart.SetPrintSolutionOneLine(j2rmode);
-        is >> out_warmstart;
-        result0 = STT_solver_0.Resolve(out_warmstart); 
-      }
-      else
+    //runners of the stages in place of the EasyLocal solvers, always with threads > 1 and in a batch (the EasyLocal solvers
+    //are built on the stages of the run of main only)
+    bool own_runners = bounded_evaluation || time_limit.IsSet() || adaptive_rates || stagnation_evaluations > 0 || threads > 1 || instance_dir.IsSet();
+
+    // solves the run with the method and returns its result; the output other than the json (as with verbose_mode)
+    // goes to os
+    auto run_method = [&](STT_Run& r, bool one_line, ostream& os) {
+      STT_Runner* runner_0 = replicas > 1 ? static_cast<STT_Runner*>(&r.PT_0) : own_runners || (method.IsSet() && method == string("ESA-SO")) ? &r.SA_0 : nullptr;
+      STT_Runner* runner_1 = replicas > 1 ? static_cast<STT_Runner*>(&r.PT_1) : own_runners ? &r.SA_1 : nullptr;
+      STT_Runner* runner_1_2 = replicas > 1 ? static_cast<STT_Runner*>(&r.PT_1_2) : own_runners ? &r.SA_1_2 : nullptr;
+      STT_Runner* runner_2 = replicas > 1 ? static_cast<STT_Runner*>(&r.PT_2) : own_runners ? &r.SA_2 : nullptr;
+      STT_RunResult run_result;
+      ostringstream json;
+      int cost;
+      double time;
+
+      STT_Solution out0(r.in0, display_OF);
+      out0.SetPrintSolutionOneLine(one_line);
+      SolverResult<STT_Input, STT_Solution> result0(out0);
+
+      if (method.IsSet() && (method == string("ESA-0") || method == string("ESA-SO"))) //ESA-0 = Esamodal Simulated Annealing - Single Stage, ESA-SO = the same with Strategic Oscillation of the hard weights
       {
-        result0 = STT_solver_0.Solve();
-      }
+        if (!runner_0)
+        {
+          STT_ESA_0.SetParameter("start_temperature", static_cast<double>(start_temperature_0));
+          STT_ESA_0.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_0));
+          STT_ESA_0.SetParameter("cooling_rate", static_cast<double>(cooling_rate_0));
+          STT_ESA_0.SetParameter("max_evaluations", static_cast<unsigned long int>(r.settings.max_evaluations_0));
+          STT_ESA_0.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_0));
+          STT_solver_0.SetRunner(STT_ESA_0);
+        }
+        r.PT_0.SetParameters(start_temperature_0, expected_min_temperature_0, r.settings.max_evaluations_0, swap_interval);
+        r.SA_0.SetParameters(start_temperature_0, expected_min_temperature_0, r.settings.max_evaluations_0);
+        r.SA_0.SetCooling(cooling_rate_0, neighbors_accepted_ratio_0);
+        if (method == string("ESA-SO"))
+          r.SA_0.SetOscillation(oscillation_interval, feasible_window, max_factor);
+        if (time_limit.IsSet())
+        {
+          r.PT_0.SetTimeLimit(time_limit);
+          r.SA_0.SetTimeLimit(time_limit);
+        }
+
+        if(init_state.IsSet())
+        {
+          ifstream is(static_cast<string>(init_state));
+          STT_Solution out_warmstart(r.in0, display_OF);
+          //out_warmstart.SetPrintSolutionOneLine(one_line);
+          is >> out_warmstart;
+          result0 = runner_0 ? runner_0->Resolve(out_warmstart) : STT_solver_0.Resolve(out_warmstart);
+        }
+        else
+        {
+          result0 = runner_0 ? runner_0->Solve() : STT_solver_0.Solve();
+        }
 
-      out0 = result0.output;
-      time = result0.running_time;
-      // per poter confrontare i differenti costi ottenuti da differenti valori di stt_hard_weight e stt_phased_weight,
-      // li reimposto entrambi a "DEFAULT_HARD_WEIGHT" prima di restituire a schermo il costo
-      // della soluzione trovata
-      out0.stt_hard_weight = DEFAULT_HARD_WEIGHT;
-      out0.stt_phased_weight = DEFAULT_HARD_WEIGHT;
+        out0 = result0.output;
+        time = result0.running_time;
+        // per poter confrontare i differenti costi ottenuti da differenti valori di stt_hard_weight e stt_phased_weight,
+        // li reimposto entrambi a "DEFAULT_HARD_WEIGHT" prima di restituire a schermo il costo
+        // della soluzione trovata
+        out0.stt_hard_weight = DEFAULT_HARD_WEIGHT;
+        out0.stt_phased_weight = DEFAULT_HARD_WEIGHT;
 
-      cost = out0.CalculateFullCost();
+        cost = out0.ApplyWeights();
 
-      if (output_file.IsSet())
-      {
-        string output_file_name = output_file;          
+        if (output_file.IsSet())
+        {
+          string output_file_name = output_file;          
         
-        cout << "Cost: " << cost << endl;
-        if (output_file_name.find(".xml") != string::npos)
-          {
-            sm0.PrettyPrintOutput(out0, output_file_name);
-          }
-        else // file txt
-          {
-            ofstream os(output_file_name);
-            os << out0 << endl;
-            os << "Cost: " << cost << endl;
-            os << "Time: " << time << "s " << endl;
-            os << "Seed: " << Random::GetSeed() << endl;
-          }
+          os << "Cost: " << cost << endl;
+          if (output_file_name.find(".xml") != string::npos)
+            {
+              r.sm0.PrettyPrintOutput(out0, output_file_name);
+            }
+          else // file txt
+            {
+              ofstream os(output_file_name);
+              os << out0 << endl;
+              os << "Cost: " << cost << endl;
+              os << "Time: " << time << "s " << endl;
+              os << "Seed: " << r.seed << endl;
+            }
+        }
+        else
+        {
+          json << "\"cost\": " << cost
+          << ", \"phase_cost\":" << out0.cost_phased
+          << ", \"hard_cost\":" << out0.total_cost_components_hard
+          << ", \"stage_1 attempts\":" << "0"
+          << ", \"CA1\":" << out0.cost_components[CA1]  
+          << ", \"CA2\":" << out0.cost_components[CA2]  
+          << ", \"CA3\":" << out0.cost_components[CA3]  
+          << ", \"CA4\":" << out0.cost_components[CA4]  
+          << ", \"GA1\":" << out0.cost_components[GA1]  
+          << ", \"BR1\":" << out0.cost_components[BR1]  
+          << ", \"BR2\":" << out0.cost_components[BR2]  
+          << ", \"FA2\":" << out0.cost_components[FA2]  
+          << ", \"SE1\":" << out0.cost_components[SE1]  
+          << ", \"time\":" << time
+          << ", \"time_stage_1\":" << time
+          << ", \"out\": \"\'" << out0 << "\'\""
+          << ", \"seed\":" << r.seed;
+        }
+        run_result.hard_cost = out0.total_cost_components_hard;
       }
-      else
+      else if (method.IsSet() && (method == string("ESA-3S") || method == string("ESA-2S") || method == string("ESA-2S-OH"))) //ESA-2S = 2 Stages with all constraints in phase1, ESA-2S-OH = 2 Stages with only hard constraints in phase 1
       {
-        cout << "{\"cost\": " << cost
-        << ", \"phase_cost\":" << out0.cost_phased
-        << ", \"hard_cost\":" << out0.total_cost_components_hard
-        << ", \"stage_1 attempts\":" << "0"
-        << ", \"CA1\":" << out0.cost_components[CA1]  
-        << ", \"CA2\":" << out0.cost_components[CA2]  
-        << ", \"CA3\":" << out0.cost_components[CA3]  
-        << ", \"CA4\":" << out0.cost_components[CA4]  
-        << ", \"GA1\":" << out0.cost_components[GA1]  
-        << ", \"BR1\":" << out0.cost_components[BR1]  
-        << ", \"BR2\":" << out0.cost_components[BR2]  
-        << ", \"FA2\":" << out0.cost_components[FA2]  
-        << ", \"SE1\":" << out0.cost_components[SE1]  
-        << ", \"time\":" << time
-        << ", \"time_stage_1\":" << time
-        << ", \"out\": \"\'" << out0 << "\'\""
-        << ", \"seed\":" << Random::GetSeed()
-        << "}" << endl;
-      } 
-    }
-    else if (method.IsSet() && (method == string("ESA-3S") || method == string("ESA-2S") || method == string("ESA-2S-OH"))) //ESA-2S = 2 Stages with all constraints in phase1, ESA-2S-OH = 2 Stages with only hard constraints in phase 1
-    {
-      int stage1_attempts = 1;
-      double time_stage_1;
-      STT_Solution out1(in1, display_OF);
-      //out1.SetPrintSolutionOneLine(j2rmode);
-      SolverResult<STT_Input, STT_Solution> result1(out1);
+        int stage1_attempts = 1;
+        double time_stage_1;
+        STT_Solution out1(r.in1, display_OF);
+        //out1.SetPrintSolutionOneLine(one_line);
+        SolverResult<STT_Input, STT_Solution> result1(out1);
       
-      unsigned long int evaluations_first_stage = 0;
+        unsigned long int evaluations_first_stage = 0;
 
 
-      if(method == string("ESA-2S")) //in questo caso applichiamo lo stesso calcolo dell'ESA-0
-        evaluations_first_stage = max_evaluations_0; 
-      if(method == string("ESA-2S-OH") || method == string("ESA-3S"))
-        evaluations_first_stage = max_evaluations_1;
+        if(method == string("ESA-2S")) //in questo caso applichiamo lo stesso calcolo dell'ESA-0
+          evaluations_first_stage = r.settings.max_evaluations_0; 
+        if(method == string("ESA-2S-OH") || method == string("ESA-3S"))
+          evaluations_first_stage = r.settings.max_evaluations_1;
 
     
-      STT_ESA_1.SetParameter("start_temperature", static_cast<double>(start_temperature_1));
-      STT_ESA_1.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_1));
-      STT_ESA_1.SetParameter("cooling_rate", static_cast<double>(cooling_rate_1));
-      STT_ESA_1.SetParameter("max_evaluations", static_cast<unsigned long int>(evaluations_first_stage));
-      STT_ESA_1.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_1));
-      STT_solver_1.SetRunner(STT_ESA_1);
-      //ESECUZIONE STAGE 1
-      if(init_state.IsSet())
-      {
-        ifstream is(static_cast<string>(init_state));
-        STT_Solution out_warmstart(in1, display_OF);
-        //out_warmstart.SetPrintSolutionOneLine(j2rmode);
-        is >> out_warmstart;
-        result1 = STT_solver_1.Resolve(out_warmstart);
-      }
-      else
-      {
-        result1 = STT_solver_1.Solve();
-      }
+        if (!runner_1)
+        {
+          STT_ESA_1.SetParameter("start_temperature", static_cast<double>(start_temperature_1));
+          STT_ESA_1.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_1));
+          STT_ESA_1.SetParameter("cooling_rate", static_cast<double>(cooling_rate_1));
+          STT_ESA_1.SetParameter("max_evaluations", static_cast<unsigned long int>(evaluations_first_stage));
+          STT_ESA_1.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_1));
+          STT_solver_1.SetRunner(STT_ESA_1);
+        }
+        r.PT_1.SetParameters(start_temperature_1, expected_min_temperature_1, evaluations_first_stage, swap_interval);
+        r.SA_1.SetParameters(start_temperature_1, expected_min_temperature_1, evaluations_first_stage);
+        r.SA_1.SetCooling(cooling_rate_1, neighbors_accepted_ratio_1);
+        if (time_limit.IsSet())
+        {
+          //each stage gets the share of the time left proportional to its max_evaluations among the stages left,
+          //so that the time not used by a stage (e.g., exiting at zero hard cost) goes to the following ones
+          double time_stage = time_limit * evaluations_first_stage / static_cast<double>(evaluations_first_stage + (method == string("ESA-3S") ? static_cast<unsigned long int>(r.settings.max_evaluations_1_2) : 0) + r.settings.max_evaluations_2);
+          r.PT_1.SetTimeLimit(time_stage);
+          r.SA_1.SetTimeLimit(time_stage);
+        }
+        //ESECUZIONE STAGE 1
+        if(init_state.IsSet())
+        {
+          ifstream is(static_cast<string>(init_state));
+          STT_Solution out_warmstart(r.in1, display_OF);
+          //out_warmstart.SetPrintSolutionOneLine(one_line);
+          is >> out_warmstart;
+          result1 = runner_1 ? runner_1->Resolve(out_warmstart) : STT_solver_1.Resolve(out_warmstart);
+        }
+        else
+        {
+          result1 = runner_1 ? runner_1->Solve() : STT_solver_1.Solve();
+        }
 
-      out1 = result1.output;
-      time = result1.running_time;
-      time_stage_1 = time;
+        out1 = result1.output;
+        time = result1.running_time;
+        time_stage_1 = time;
 
-      // visto che in1 non aveva i costi hard, per calcolare lo stage 1 con costo + f.ob.
-      // costruisco un input di appoggio
+        // visto che r.in1 non aveva i costi hard, per calcolare lo stage 1 con costo + f.ob.
+        // costruisco un input di appoggio
 
-      STT_Input in1_bis(instance, DEFAULT_HARD_WEIGHT, DEFAULT_HARD_WEIGHT, false, mix_phase_during_search, false, exit_at_zero_hard_stage1, {1, 1, 1, 1, 1, 1, 1, 1, 1});
-      STT_Solution out1_bis(in1_bis, display_OF);
-      //out1_bis.SetPrintSolutionOneLine(j2rmode);
+        STT_Input in1_bis(r.instance, DEFAULT_HARD_WEIGHT, DEFAULT_HARD_WEIGHT, false, mix_phase_during_search, false, exit_at_zero_hard_stage1, {1, 1, 1, 1, 1, 1, 1, 1, 1});
+        STT_Solution out1_bis(in1_bis, display_OF);
+        //out1_bis.SetPrintSolutionOneLine(one_line);
       
       
 
-      ostringstream ostreammio_1_bis;
-      ostreammio_1_bis << out1;
-      istringstream istreammio_1_bis(ostreammio_1_bis.str());
-      istreammio_1_bis >> out1_bis;
-      out1_bis.CalculateFullCost();
+        out1_bis.LoadTimetable(out1);
 
       
-      if(verbose_mode)
-      {
-        cout << "Found feasible solution at Stage 1" << endl;
-        cout << "{\"cost\": " << out1_bis.ReturnTotalCost()
-            << ", \"phase_cost\":" << out1_bis.cost_phased
-            << ", \"hard_cost\":" << out1_bis.total_cost_components_hard
-            << ", \"stage_1 attempts\":" << stage1_attempts
-            << ", \"CA1\":" << out1_bis.cost_components[CA1]  
-            << ", \"CA2\":" << out1_bis.cost_components[CA2]  
-            << ", \"CA3\":" << out1_bis.cost_components[CA3]  
-            << ", \"CA4\":" << out1_bis.cost_components[CA4]  
-            << ", \"GA1\":" << out1_bis.cost_components[GA1]  
-            << ", \"BR1\":" << out1_bis.cost_components[BR1]  
-            << ", \"BR2\":" << out1_bis.cost_components[BR2]  
-            << ", \"FA2\":" << out1_bis.cost_components[FA2]  
-            << ", \"SE1\":" << out1_bis.cost_components[SE1]  
-            << ", \"time\":" << time
-            << ", \"out\": \"\'" << out1_bis << "\'\""
-            << ", \"seed\":" << Random::GetSeed()
-            << "}" << endl;
+        if(verbose_mode)
+        {
+          os << "Found feasible solution at Stage 1" << endl;
+          os << "{\"cost\": " << out1_bis.ReturnTotalCost()
+              << ", \"phase_cost\":" << out1_bis.cost_phased
+              << ", \"hard_cost\":" << out1_bis.total_cost_components_hard
+              << ", \"stage_1 attempts\":" << stage1_attempts
+              << ", \"CA1\":" << out1_bis.cost_components[CA1]  
+              << ", \"CA2\":" << out1_bis.cost_components[CA2]  
+              << ", \"CA3\":" << out1_bis.cost_components[CA3]  
+              << ", \"CA4\":" << out1_bis.cost_components[CA4]  
+              << ", \"GA1\":" << out1_bis.cost_components[GA1]  
+              << ", \"BR1\":" << out1_bis.cost_components[BR1]  
+              << ", \"BR2\":" << out1_bis.cost_components[BR2]  
+              << ", \"FA2\":" << out1_bis.cost_components[FA2]  
+              << ", \"SE1\":" << out1_bis.cost_components[SE1]  
+              << ", \"time\":" << time
+              << ", \"out\": \"\'" << out1_bis << "\'\""
+              << ", \"seed\":" << r.seed
+              << "}" << endl;
 
-        cout << "#################################################" << endl
-            << "I start Phase 2 (or Phase1_2 if method is ESA-3S)" << endl 
-            << "##################################################" << endl;
-      }
+          os << "#################################################" << endl
+              << "I start Phase 2 (or Phase1_2 if method is ESA-3S)" << endl 
+              << "##################################################" << endl;
+        }
       
-      STT_Solution out1_2(in1_2, display_OF);
-      //out1_2.SetPrintSolutionOneLine(j2rmode);
-      ostringstream ostreammio_1_2;
-      ostreammio_1_2 << out1;
-      istringstream istreammio_1_2(ostreammio_1_2.str());
-      STT_Solution out_warmstart_1_2(in1_2, display_OF);
-      //out_warmstart_1_2.SetPrintSolutionOneLine(j2rmode);
-      istreammio_1_2 >> out_warmstart_1_2;
-      SolverResult<STT_Input, STT_Solution> result1_2(out1_2);
-      double time_stage_1_2 = 0;
-      if(method == string("ESA-3S"))
-      {
-        STT_ESA_1_2.SetParameter("start_temperature", static_cast<double>(start_temperature_1_2));
-        STT_ESA_1_2.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_1_2));
-        STT_ESA_1_2.SetParameter("cooling_rate", static_cast<double>(cooling_rate_1_2));
-        STT_ESA_1_2.SetParameter("max_evaluations", static_cast<unsigned long int>(max_evaluations_1_2));
-        STT_ESA_1_2.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_1_2));
-        STT_solver_1_2.SetRunner(STT_ESA_1_2);
-        result1_2 = STT_solver_1_2.Resolve(out_warmstart_1_2);
+        STT_Solution out1_2(r.in1_2, display_OF);
+        //out1_2.SetPrintSolutionOneLine(one_line);
+        STT_Solution out_warmstart_1_2(r.in1_2, display_OF);
+        //out_warmstart_1_2.SetPrintSolutionOneLine(one_line);
+        out_warmstart_1_2.LoadTimetable(out1);
+        SolverResult<STT_Input, STT_Solution> result1_2(out1_2);
+        double time_stage_1_2 = 0;
+        if(method == string("ESA-3S"))
+        {
+          if (!runner_1_2)
+          {
+            STT_ESA_1_2.SetParameter("start_temperature", static_cast<double>(start_temperature_1_2));
+            STT_ESA_1_2.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_1_2));
+            STT_ESA_1_2.SetParameter("cooling_rate", static_cast<double>(cooling_rate_1_2));
+            STT_ESA_1_2.SetParameter("max_evaluations", static_cast<unsigned long int>(r.settings.max_evaluations_1_2));
+            STT_ESA_1_2.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_1_2));
+            STT_solver_1_2.SetRunner(STT_ESA_1_2);
+          }
+          r.PT_1_2.SetParameters(start_temperature_1_2, expected_min_temperature_1_2, r.settings.max_evaluations_1_2, swap_interval);
+          r.SA_1_2.SetParameters(start_temperature_1_2, expected_min_temperature_1_2, r.settings.max_evaluations_1_2);
+          r.SA_1_2.SetCooling(cooling_rate_1_2, neighbors_accepted_ratio_1_2);
+          if (time_limit.IsSet())
+          {
+            double time_stage = max(time_limit - time, 0.0) * r.settings.max_evaluations_1_2 / static_cast<double>(r.settings.max_evaluations_1_2 + r.settings.max_evaluations_2);
+            r.PT_1_2.SetTimeLimit(time_stage);
+            r.SA_1_2.SetTimeLimit(time_stage);
+          }
+          result1_2 = runner_1_2 ? runner_1_2->Resolve(out_warmstart_1_2) : STT_solver_1_2.Resolve(out_warmstart_1_2);
         
-        out1_2 = result1_2.output;
-        time = time + result1_2.running_time;
-        time_stage_1_2 = result1_2.running_time;
+          out1_2 = result1_2.output;
+          time = time + result1_2.running_time;
+          time_stage_1_2 = result1_2.running_time;
 
-        out1_2.stt_hard_weight = DEFAULT_HARD_WEIGHT;
-        out1_2.stt_phased_weight = DEFAULT_HARD_WEIGHT;
+          out1_2.stt_hard_weight = DEFAULT_HARD_WEIGHT;
+          out1_2.stt_phased_weight = DEFAULT_HARD_WEIGHT;
         
-        for(unsigned h = 0; h < in1_2.hard_weights.size(); h++)
-        {
-          in1_2.hard_weights[h] = 1;
-        }
+          for(unsigned h = 0; h < r.in1_2.hard_weights.size(); h++)
+          {
+            r.in1_2.hard_weights[h] = 1;
+          }
 
-        out1_2.CalculateFullCost();
+          out1_2.ApplyWeights();
         
 
-        if(verbose_mode)
-        {
-          cerr << "Found solution at Stage 1_2" << endl;
-          cerr << "{\"cost\": " << out1_2.ReturnTotalCost()
-              << ", \"phase_cost\":" << out1_2.cost_phased
-              << ", \"hard_cost\":" << out1_2.total_cost_components_hard
-              << ", \"stage_1 attempts\":" << stage1_attempts
-              << ", \"CA1\":" << out1_2.cost_components[CA1]  
-              << ", \"CA2\":" << out1_2.cost_components[CA2]  
-              << ", \"CA3\":" << out1_2.cost_components[CA3]  
-              << ", \"CA4\":" << out1_2.cost_components[CA4]  
-              << ", \"GA1\":" << out1_2.cost_components[GA1]  
-              << ", \"BR1\":" << out1_2.cost_components[BR1]  
-              << ", \"BR2\":" << out1_2.cost_components[BR2]  
-              << ", \"FA2\":" << out1_2.cost_components[FA2]  
-              << ", \"SE1\":" << out1_2.cost_components[SE1]  
-              << ", \"time\":" << time
-              << ", \"time_stage_1_2\":" << time_stage_1_2
-              << ", \"out\": \"\'" << out1_2 << "\'\""
-              << ", \"seed\":" << Random::GetSeed()
-              << "}" << endl;
-
-          cerr << "###################" << endl
-              << "I start Phase 2" << endl 
-              << "###################" << endl;
+          if(verbose_mode)
+          {
+            cerr << "Found solution at Stage 1_2" << endl;
+            cerr << "{\"cost\": " << out1_2.ReturnTotalCost()
+                << ", \"phase_cost\":" << out1_2.cost_phased
+                << ", \"hard_cost\":" << out1_2.total_cost_components_hard
+                << ", \"stage_1 attempts\":" << stage1_attempts
+                << ", \"CA1\":" << out1_2.cost_components[CA1]  
+                << ", \"CA2\":" << out1_2.cost_components[CA2]  
+                << ", \"CA3\":" << out1_2.cost_components[CA3]  
+                << ", \"CA4\":" << out1_2.cost_components[CA4]  
+                << ", \"GA1\":" << out1_2.cost_components[GA1]  
+                << ", \"BR1\":" << out1_2.cost_components[BR1]  
+                << ", \"BR2\":" << out1_2.cost_components[BR2]  
+                << ", \"FA2\":" << out1_2.cost_components[FA2]  
+                << ", \"SE1\":" << out1_2.cost_components[SE1]  
+                << ", \"time\":" << time
+                << ", \"time_stage_1_2\":" << time_stage_1_2
+                << ", \"out\": \"\'" << out1_2 << "\'\""
+                << ", \"seed\":" << r.seed
+                << "}" << endl;
+
+            cerr << "###################" << endl
+                << "I start Phase 2" << endl 
+                << "###################" << endl;
+          }
         }
-      }
 
         
-      STT_Solution out2(in2, display_OF);
-      //out2.SetPrintSolutionOneLine(j2rmode);
-      ostringstream ostreammio;
-      if(method == string("ESA-3S")) //se ho usato il 3-stage, per l'ultimo stage leggo out1_2
-      {
-        if(out1_bis.ReturnTotalCost() < out1_2.ReturnTotalCost())
-          ostreammio << out1_bis;
+        STT_Solution out2(r.in2, display_OF);
+        //out2.SetPrintSolutionOneLine(one_line);
+        STT_Solution out_warmstart_2(r.in2, display_OF);
+        //out_warmstart_2.SetPrintSolutionOneLine(one_line);
+        if(method == string("ESA-3S")) //se ho usato il 3-stage, per l'ultimo stage leggo out1_2
+        {
+          if(out1_bis.ReturnTotalCost() < out1_2.ReturnTotalCost())
+            out_warmstart_2.LoadTimetable(out1_bis);
+          else
+            out_warmstart_2.LoadTimetable(out1_2);
+        }
         else
-          ostreammio << out1_2;
-      }
-      else
-      {
-        ostreammio << out1; //altrimenti leggo out1
-      }
-
-      istringstream istreammio(ostreammio.str());
-      STT_Solution out_warmstart_2(in2, display_OF);
-      //out_warmstart_2.SetPrintSolutionOneLine(j2rmode);
-      istreammio >> out_warmstart_2;
+        {
+          out_warmstart_2.LoadTimetable(out1); //altrimenti leggo out1
+        }
 
-      STT_ESA_2.SetParameter("start_temperature", static_cast<double>(start_temperature_2));
-      STT_ESA_2.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_2));
-      STT_ESA_2.SetParameter("cooling_rate", static_cast<double>(cooling_rate_2));
-      STT_ESA_2.SetParameter("max_evaluations", static_cast<unsigned long int>(max_evaluations_2));
-      STT_ESA_2.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_2));
-      STT_solver_2.SetRunner(STT_ESA_2);
+        if (!runner_2)
+        {
+          STT_ESA_2.SetParameter("start_temperature", static_cast<double>(start_temperature_2));
+          STT_ESA_2.SetParameter("expected_min_temperature", static_cast<double>(expected_min_temperature_2));
+          STT_ESA_2.SetParameter("cooling_rate", static_cast<double>(cooling_rate_2));
+          STT_ESA_2.SetParameter("max_evaluations", static_cast<unsigned long int>(r.settings.max_evaluations_2));
+          STT_ESA_2.SetParameter("neighbors_accepted_ratio", static_cast<double>(neighbors_accepted_ratio_2));
+          STT_solver_2.SetRunner(STT_ESA_2);
+        }
+        r.PT_2.SetParameters(start_temperature_2, expected_min_temperature_2, r.settings.max_evaluations_2, swap_interval);
+        r.SA_2.SetParameters(start_temperature_2, expected_min_temperature_2, r.settings.max_evaluations_2);
+        r.SA_2.SetCooling(cooling_rate_2, neighbors_accepted_ratio_2);
+        if (time_limit.IsSet())
+        {
+          r.PT_2.SetTimeLimit(max(time_limit - time, 0.0));
+          r.SA_2.SetTimeLimit(max(time_limit - time, 0.0));
+        }
 
-      SolverResult<STT_Input, STT_Solution> result2(out2);
+        SolverResult<STT_Input, STT_Solution> result2(out2);
 
-      result2 = STT_solver_2.Resolve(out_warmstart_2);
-      out2 = result2.output;
+        result2 = runner_2 ? runner_2->Resolve(out_warmstart_2) : STT_solver_2.Resolve(out_warmstart_2);
+        out2 = result2.output;
 
-      // per poter confrontare i differenti costi ottenuti da differenti valori di stt_hard_weight e stt_phased_weight,
-      // li reimposto entrambi a "DEFAULT_HARD_WEIGHT" prima di restituire a schermo il costo
-      // della soluzione trovata
-      out2.stt_hard_weight = DEFAULT_HARD_WEIGHT;
-      out2.stt_phased_weight = DEFAULT_HARD_WEIGHT;
+        // per poter confrontare i differenti costi ottenuti da differenti valori di stt_hard_weight e stt_phased_weight,
+        // li reimposto entrambi a "DEFAULT_HARD_WEIGHT" prima di restituire a schermo il costo
+        // della soluzione trovata
+        out2.stt_hard_weight = DEFAULT_HARD_WEIGHT;
+        out2.stt_phased_weight = DEFAULT_HARD_WEIGHT;
       
-      // ripristino anche i costi a 1 per calcolare il costo finale
+        // ripristino anche i costi a 1 per calcolare il costo finale
 
-      for(unsigned h = 0; h < in2.hard_weights.size(); h++)
-      {
-        in2.hard_weights[h] = 1;
-      }
-      //rimettere i pesi dei costi hard a 1
+        for(unsigned h = 0; h < r.in2.hard_weights.size(); h++)
+        {
+          r.in2.hard_weights[h] = 1;
+        }
+        //rimettere i pesi dei costi hard a 1
 
-      cost = out2.CalculateFullCost();
-      time = time + result2.running_time;
+        cost = out2.ApplyWeights();
+        time = time + result2.running_time;
 
-      if (output_file.IsSet())
-        {
-          string output_file_name = output_file;          
-          cout << "Cost: " << cost << endl;
-          if (output_file_name.find(".xml") != string::npos)
+        if (output_file.IsSet())
+          {
+            string output_file_name = output_file;          
+            os << "Cost: " << cost << endl;
+            if (output_file_name.find(".xml") != string::npos)
+              {
+                r.sm2.PrettyPrintOutput(out2, output_file_name);
+              }
+            else // file txt
+              {
+                ofstream os(output_file_name);
+                os << out2 << endl;
+                os << "Cost: " << cost << endl;
+                os << "Time: " << time << "s " << endl;
+                os << "Seed: " << r.seed << endl;
+              }
+          }
+        else
+          {
+            out2.SetPrintSolutionOneLine(one_line);
+            json << "\"cost\": " << cost
+            << ", \"phase_cost\":" << out2.cost_phased
+            << ", \"hard_cost\":" << out2.total_cost_components_hard  
+            << ", \"CA1\":" << out2.cost_components[CA1]  
+            << ", \"CA2\":" << out2.cost_components[CA2]  
+            << ", \"CA3\":" << out2.cost_components[CA3]  
+            << ", \"CA4\":" << out2.cost_components[CA4]  
+            << ", \"GA1\":" << out2.cost_components[GA1]  
+            << ", \"BR1\":" << out2.cost_components[BR1]  
+            << ", \"BR2\":" << out2.cost_components[BR2]  
+            << ", \"FA2\":" << out2.cost_components[FA2]  
+            << ", \"SE1\":" << out2.cost_components[SE1]  
+            << ", \"time\":" << time
+            << ", \"time_stage_1\":" << time_stage_1
+            << ", \"time_stage_1_2\":" << time_stage_1_2
+            << ", \"time_stage_2\":" << time - time_stage_1 -time_stage_1_2
+            << ", \"cost_stage_1\":" << out1_bis.ReturnTotalCost()
+            << ", \"cost_stage_1_2\":" << out1_2.ReturnTotalCost();
+            if(print_full_solution || verbose_mode)
+              json << ", \"out\": \"\'" << out2 << "\'\"";
+            json << ", \"seed\":" << r.seed;
+          } 
+        run_result.hard_cost = out2.total_cost_components_hard;
+      }
+      else
+      {
+        throw invalid_argument(string("Unknown method ") + string(method));
+      }
+      run_result.completed = true;
+      run_result.cost = cost;
+      run_result.time = time;
+      run_result.json = json.str();
+      return run_result;
+    };
+
+    if (instance_dir.IsSet())
+    {
+      // batch: each instance gets its own run, with the seed and the settings of a run on it alone, and the threads take
+      // the instances to solve from a queue, the ones with more constraints first (as they are expected to take longer);
+      // the solutions are printed on one line, as they are inside the json of the batch
+      vector<unsigned> order;
+      for (unsigned i = 0; i < batch.size(); i++)
+        if (batch[i].instance)
+          order.push_back(i);
+      sort(order.begin(), order.end(), [&](unsigned i, unsigned j) { return batch[i].constraints > batch[j].constraints || (batch[i].constraints == batch[j].constraints && i < j); });
+      vector<STT_RunResult> results(batch.size());
+      atomic<unsigned> next(0);
+      vector<thread> workers;
+      for (unsigned w = 0; w < min(static_cast<unsigned>(static_cast<int>(threads)), static_cast<unsigned>(order.size())); w++)
+        workers.emplace_back([&] {
+          for (unsigned k = next++; k < order.size(); k = next++)
+          {
+            unsigned i = order[k];
+            ostringstream log; //the output of the runs other than their json is not printed
+            if (!batch[i].instance->phased && mix_phase_during_search == false)
             {
-              sm2.PrettyPrintOutput(out2, output_file_name);
+              results[i].failure = "instance is not phased and mix_phase_during_search set as false";
+              continue;
             }
-          else // file txt
+            try
             {
-              ofstream os(output_file_name);
-              os << out2 << endl;
-              os << "Cost: " << cost << endl;
-              os << "Time: " << time << "s " << endl;
-              os << "Seed: " << Random::GetSeed() << endl;
+              STT_Run run(batch[i].instance, main_run.seed, run_options, run_settings(*batch[i].instance));
+              results[i] = run_method(run, true, log);
             }
-        }
-      else
-        {
-          out2.SetPrintSolutionOneLine(j2rmode);
-          cout << "{\"cost\": " << cost
-          << ", \"phase_cost\":" << out2.cost_phased
-          << ", \"hard_cost\":" << out2.total_cost_components_hard  
-          << ", \"CA1\":" << out2.cost_components[CA1]  
-          << ", \"CA2\":" << out2.cost_components[CA2]  
-          << ", \"CA3\":" << out2.cost_components[CA3]  
-          << ", \"CA4\":" << out2.cost_components[CA4]  
-          << ", \"GA1\":" << out2.cost_components[GA1]  
-          << ", \"BR1\":" << out2.cost_components[BR1]  
-          << ", \"BR2\":" << out2.cost_components[BR2]  
-          << ", \"FA2\":" << out2.cost_components[FA2]  
-          << ", \"SE1\":" << out2.cost_components[SE1]  
-          << ", \"time\":" << time
-          << ", \"time_stage_1\":" << time_stage_1
-          << ", \"time_stage_1_2\":" << time_stage_1_2
-          << ", \"time_stage_2\":" << time - time_stage_1 -time_stage_1_2
-          << ", \"cost_stage_1\":" << out1_bis.ReturnTotalCost()
-          << ", \"cost_stage_1_2\":" << out1_2.ReturnTotalCost();
-          if(print_full_solution || verbose_mode)
-            cout << ", \"out\": \"\'" << out2 << "\'\"";
-          cout << ", \"seed\":" << Random::GetSeed()
-          << "}" << endl;
-        } 
+            catch (exception& e)
+            {
+              results[i].failure = e.what();
+            }
+            catch (...)
+            {
+              results[i].failure = "unknown exception";
+            }
+          }
+        });
+      for (auto& w : workers)
+        w.join();
+      PrintBatch(batch, results);
+      return 0;
     }
-    else
+
+    if (threads > 1)
     {
-      throw invalid_argument(string("Unknown method ") + string(method));
+      // multi-start: the run of main and threads - 1 more, with seeds seed + 1, seed + 2, ... (so that each of them can be
+      // reproduced alone), are solved each in its own thread; the json of the best one is printed with the statistics of
+      // all (the failed runs included), and the exit status is 1 if no run has completed
+      vector<unique_ptr<STT_Run>> more_runs;
+      vector<STT_Run*> runs{&main_run};
+      for (int w = 1; w < threads; w++)
+      {
+        more_runs.push_back(make_unique<STT_Run>(stt_instance, main_run.seed + w, run_options, main_run.settings));
+        runs.push_back(more_runs.back().get());
+      }
+      vector<STT_RunResult> results(threads);
+      vector<thread> workers;
+      for (int w = 0; w < threads; w++)
+        workers.emplace_back([&, w] {
+          ostringstream log; //the output of the runs other than their json is not printed
+          try
+          {
+            results[w] = run_method(*runs[w], j2rmode, log);
+          }
+          catch (exception& e)
+          {
+            results[w].failure = e.what();
+          }
+          catch (...)
+          {
+            results[w].failure = "unknown exception";
+          }
+        });
+      for (auto& w : workers)
+        w.join();
+
+      int best = -1;
+      for (int w = 0; w < threads; w++)
+        if (results[w].completed && (best == -1 || results[w].cost < results[best].cost))
+          best = w;
+      cout << "{";
+      if (best != -1)
+        cout << results[best].json << ", \"best_thread\":" << best << ", ";
+      cout << "\"threads\":" << threads << ", \"runs\": [";
+      for (int w = 0; w < threads; w++)
+      {
+        cout << (w > 0 ? ", " : "") << "{\"thread\":" << w << ", \"seed\":" << runs[w]->seed;
+        if (results[w].completed)
+          cout << ", \"cost\":" << results[w].cost
+               << ", \"hard_cost\":" << results[w].hard_cost
+               << ", \"time\":" << results[w].time;
+        else
+          cout << ", \"failed\": \"" << JsonEscape(results[w].failure.empty() ? "unknown exception" : results[w].failure) << "\"";
+        cout << "}";
+      }
+      cout << "]}" << endl;
+      return best == -1 ? 1 : 0;
     }
+
+    STT_RunResult result = run_method(main_run, j2rmode, cout);
+    if (!result.json.empty())
+      cout << "{" << result.json << "}" << endl;
   } 
     return 0;
 }
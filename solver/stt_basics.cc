@@ -339,7 +339,7 @@ bool STT_Solution::InternalCheckConsistency() const
 
     //check cost consistency (check that costs are aligned)
     //copio i costi
-    vector<int> cost_components_copied = cost_components;
+    vector<int> cost_components_copied(cost_components, cost_components + N_CONSTRAINTS);
     //ricalcolo i costi con le funzioni canoniche
     STT_Solution solution_copy = *this;
     solution_copy.CalculateFullCost();
@@ -363,6 +363,26 @@ bool STT_Solution::InternalCheckConsistency() const
         count_consistency++;
       }
     
+    //check the set of the violated constraints
+    unsigned violated = 0;
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+      for (unsigned int c = 0; c < in.ConstraintsVectorSize(c_type); c++)
+      {
+        unsigned p = violated_position[c_type][c];
+        if ((violations[c_type][c] > 0) != (p != 0) || (p != 0 && (violated_types[p - 1] != c_type || violated_constraints[p - 1] != c)))
+        {
+          cout << "unconsistency found, constraint " << c << " of type " << static_cast<Constraints::ConstraintType>(c_type) << " not aligned with the violated set" << endl;
+          count_consistency++;
+        }
+        if (violations[c_type][c] > 0)
+          violated++;
+      }
+    if (violated != violated_count)
+    {
+      cout << "unconsistency found, " << violated << " violated constraints but the violated set has size " << violated_count << endl;
+      count_consistency++;
+    }
+    
     //se il numero di andate e ritorni non coincide, stampo la matrice
     if(PrintIsReturnMatrix(true) != 0)
         PrintIsReturnMatrix();
@@ -383,7 +403,7 @@ string STT_Solution::PrintCostComponentsCompacted() const
   return s;
 }
 
-void STT_Solution::CanonicalPattern(bool permute, bool mix_initial_phase)
+void STT_Solution::CanonicalPattern(STT_Random& rng, bool permute, bool mix_initial_phase)
 {
   // generate the canonical pattern
   size_t n = in.teams.size(), r = in.slots.size();
@@ -436,14 +456,14 @@ void STT_Solution::CanonicalPattern(bool permute, bool mix_initial_phase)
   // permute the teams in the pattern
   if (permute)
     {
-      Shuffle(begin(tp), end(tp)); 
+      Shuffle(rng, begin(tp), end(tp)); 
 
       if (mix_initial_phase)
-	      Shuffle(begin(rp), end(rp)); 
+	      Shuffle(rng, begin(rp), end(rp)); 
       else
       {
-        Shuffle(begin(rp), begin(rp) + r / 2); 
-        Shuffle(begin(rp) + r / 2 + 1, end(rp)); 
+        Shuffle(rng, begin(rp), begin(rp) + r / 2); 
+        Shuffle(rng, begin(rp) + r / 2 + 1, end(rp)); 
       }
 
     }
@@ -464,12 +484,12 @@ void STT_Solution::CanonicalPattern(bool permute, bool mix_initial_phase)
   PopulateIsReturnMatrix();  
 }
 
-void STT_Solution::Shuffle(vector<size_t>::iterator start, vector<size_t>::iterator stop)
-{ // We do not use the shuffle from stardard library in order to use the Random of easylocal,
+void STT_Solution::Shuffle(STT_Random& rng, vector<size_t>::iterator start, vector<size_t>::iterator stop)
+{ // We do not use the shuffle from stardard library in order to draw from rng with the same sequence on every platform,
   // so that each run can be reproduced giving the seed
   for (vector<size_t>::iterator it = start; it < stop; it++)
     {
-      size_t v = Random::Uniform<size_t>(0, stop-it-1);
+      size_t v = rng.Uniform<size_t>(0, stop-it-1);
       swap(*it,*(it + v));
     }
 }
@@ -481,31 +501,42 @@ void STT_Solution::UpdateStateCell(unsigned t1, unsigned r, unsigned t2, bool ho
     // update match
     if (home_game) // to prevent to do it twice, we do it only when it is a home game
     {
-      //UpdateLocalCostsDeleteMatch(t1, t2, match[t1][t2]); //modifico i costi legati al match che elimino
+      same_phase_pairs += SamePhase(r, match[t2][t1]) - SamePhase(match[t1][t2], match[t2][t1]);
       match[t1][t2] = r;
-      //UpdateLocalCostsInsertMatch(t1, t2, match[t1][t2]); //modifico i costi legati al match che aggiungo 
     }    
     
+    if (home[t1][r] != home_game && !fa2_team_touched[t1])
+    {
+      fa2_team_touched[t1] = true;
+      fa2_touched_teams[fa2_touched_count++] = t1;
+    }
+
     // update redundant data
     home[t1][r] = home_game;
+    if (home_game)
+      home_bits[t1] |= SlotBit(r);
+    else
+      home_bits[t1] &= ~SlotBit(r);
     opponent[t1][r] = t2;
 }
 
-void STT_Solution::UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1, bool rev2) //rev1, rev2 false by default
+// the following two are shared by STT_Solution and STT_SolutionOverlay, so that a move is simulated exactly as it is executed
+template <class State>
+static void UpdateMatchesOf(State& st, unsigned t1, unsigned t2, unsigned r, bool rev1, bool rev2)
 { // update the state swapping the opponent of t1 and t2
   // if rev1 = true invert the home position of t1, if rev2 = true invert the home position of t2
   
   unsigned ot1, ot2;
   bool b1, b2;
-  ot1 = opponent[t1][r];
-  ot2 = opponent[t2][r];
-  b1 = home[t1][r];
-  b2 = home[t2][r];
+  ot1 = st.Opponent(t1,r);
+  ot2 = st.Opponent(t2,r);
+  b1 = st.Home(t1,r);
+  b2 = st.Home(t2,r);
 
   if (ot1 == t2) // they play each other
   {
-    UpdateStateCell(t1,r,t2,b2);
-    UpdateStateCell(t2,r,t1,b1);
+    st.UpdateStateCell(t1,r,t2,b2);
+    st.UpdateStateCell(t2,r,t1,b1);
   }
   else
   {
@@ -519,10 +550,10 @@ void STT_Solution::UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1
     if (rev2)
       b2 = !b2;
 
-    UpdateStateCell(t1,r,ot2,b2);
-    UpdateStateCell(ot2,r,t1,!b2);
-    UpdateStateCell(t2,r,ot1,b1);
-    UpdateStateCell(ot1,r,t2,!b1);    
+    st.UpdateStateCell(t1,r,ot2,b2);
+    st.UpdateStateCell(ot2,r,t1,!b2);
+    st.UpdateStateCell(t2,r,ot1,b1);
+    st.UpdateStateCell(ot1,r,t2,!b1);    
   }
 
   //aggiorno anche is_return_match, involved teams are: t1, t2, opponent of t1, opponent of t2
@@ -532,19 +563,30 @@ void STT_Solution::UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1
   //NOTA: quanto scritto alla nota precedente per adesso non si applica, l'ho fatto nelle relative MakeMove.
 }
 
-void STT_Solution::InternalMakeSwapHomes(unsigned t1, unsigned t2)
+template <class State>
+static void InternalMakeSwapHomesOf(State& st, unsigned t1, unsigned t2)
 {
       unsigned r1, r2;
-      r1 = match[t1][t2];
-      r2 = match[t2][t1];
-      bool at_home = home[t1][r1];
-      UpdateStateCell(t1, r1, t2, !at_home);
-      UpdateStateCell(t1, r2, t2, at_home);
-      UpdateStateCell(t2, r1, t1, at_home);
-      UpdateStateCell(t2, r2, t1, !at_home);
+      r1 = st.Match(t1,t2);
+      r2 = st.Match(t2,t1);
+      bool at_home = st.Home(t1,r1);
+      st.UpdateStateCell(t1, r1, t2, !at_home);
+      st.UpdateStateCell(t1, r2, t2, at_home);
+      st.UpdateStateCell(t2, r1, t1, at_home);
+      st.UpdateStateCell(t2, r2, t1, !at_home);
       //PopulateCellInsideIsReturnMatrixAndFixRelatedMatches(t1,r1); //this will automatically fix all 2 matches (descrpition of the method:   //in addition to fixing team t in slot s, fixes also opponent of t in slot s, and the related go/return)
 }
 
+void STT_Solution::UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1, bool rev2) //rev1, rev2 false by default
+{
+  UpdateMatchesOf(*this, t1, t2, r, rev1, rev2);
+}
+
+void STT_Solution::InternalMakeSwapHomes(unsigned t1, unsigned t2)
+{
+  InternalMakeSwapHomesOf(*this, t1, t2);
+}
+
 vector<vector<vector<int>>> STT_Solution::GetCplexWarmSolution()
 {
   vector<vector<vector<int>>> x(in.teams.size(),  vector<vector<int>>(in.teams.size(), vector<int>(in.slots.size(), 0)));
@@ -562,229 +604,441 @@ int STT_Solution::ReturnTotalCost()
   return total_cost_components + cost_phased;
 }
 
+// Helper of BindStorage: hands out consecutive (suitably aligned) pieces of a block of memory;
+// with a null block it only measures the size needed
+class StorageCarver
+{
+public:
+  StorageCarver(char* block) : block(block), size(0) {}
+  template <typename T>
+  T* Carve(size_t n)
+  {
+    size = (size + alignof(T) - 1) / alignof(T) * alignof(T);
+    T* piece = block ? reinterpret_cast<T*>(block + size) : nullptr;
+    size += n * sizeof(T);
+    return piece;
+  }
+  template <typename T>
+  STT_Matrix<T> CarveMatrix(unsigned rows, unsigned columns)
+  {
+    return STT_Matrix<T>(Carve<T>(rows*columns), rows, columns);
+  }
+  template <typename T, class RowSize>
+  STT_RaggedMatrix<T> CarveRaggedMatrix(unsigned rows, RowSize row_size)
+  {
+    unsigned* offsets = Carve<unsigned>(rows + 1);
+    unsigned total = 0;
+    for (unsigned r = 0; r < rows; r++)
+    {
+      if (offsets)
+        offsets[r] = total;
+      total += row_size(r);
+    }
+    if (offsets)
+      offsets[rows] = total;
+    return STT_RaggedMatrix<T>(Carve<T>(total), offsets);
+  }
+  size_t Size() const { return size; }
+private:
+  char* block;
+  size_t size;
+};
+
+void STT_Solution::BindStorage()
+{
+  // the same carving is done twice: first to measure the block, then to bind the views on it
+  for (unsigned pass = 0; pass < 2; pass++)
+  {
+    StorageCarver carver(pass == 0 ? nullptr : reinterpret_cast<char*>(storage.data()));
+    const unsigned teams = in.teams.size(), slots = in.slots.size();
+    unsigned n_constraints = 0;
+    for (unsigned c_type = CA1; c_type <= SE1; c_type++)
+      n_constraints += in.ConstraintsVectorSize(c_type);
+    home_bits = carver.Carve<uint64_t>(teams);
+    ca3_games = carver.CarveRaggedMatrix<uint64_t>(in.constraints_CA3.size(),
+      [this](unsigned c) { return in.team_group[in.constraints_CA3[c].team_group_1_index].size(); });
+    opponent = carver.CarveMatrix<unsigned int>(teams, slots);
+    match = carver.CarveMatrix<unsigned int>(teams, teams);
+    violations_hard = carver.Carve<int>(N_CONSTRAINTS);
+    violations_soft = carver.Carve<int>(N_CONSTRAINTS);
+    cost_components = carver.Carve<int>(N_CONSTRAINTS);
+    cost_components_hard = carver.Carve<int>(N_CONSTRAINTS);
+    violations = carver.CarveRaggedMatrix<int>(N_CONSTRAINTS,
+      [this](unsigned c_type) { return in.ConstraintsVectorSize(c_type); });
+    violated_position = carver.CarveRaggedMatrix<unsigned>(N_CONSTRAINTS,
+      [this](unsigned c_type) { return in.ConstraintsVectorSize(c_type); });
+    violated_types = carver.Carve<unsigned>(n_constraints);
+    violated_constraints = carver.Carve<unsigned>(n_constraints);
+    ca3_excess = carver.Carve<int>(in.constraints_CA3.size());
+    fa2_home_games = carver.CarveRaggedMatrix<int>(in.constraints_FA2.size(),
+      [this](unsigned c) { return in.team_group[in.constraints_FA2[c].team_group_index].size() * in.slot_group[in.constraints_FA2[c].slot_group_index].size(); });
+    fa2_pair_excess = carver.CarveRaggedMatrix<int>(in.constraints_FA2.size(),
+      [this](unsigned c) { return in.team_group[in.constraints_FA2[c].team_group_index].size() * in.team_group[in.constraints_FA2[c].team_group_index].size(); });
+    fa2_excess = carver.Carve<int>(in.constraints_FA2.size());
+    fa2_touched_teams = carver.Carve<unsigned>(teams);
+    home = carver.CarveMatrix<bool>(teams, slots);
+    is_return_match = carver.CarveMatrix<bool>(teams, slots);
+    fa2_team_touched = carver.Carve<bool>(teams);
+    if (pass == 0)
+      storage.assign((carver.Size() + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+  }
+}
+
+void STT_Solution::PackHomeBits()
+{
+  for (unsigned t = 0; t < in.teams.size(); t++)
+  {
+    home_bits[t] = 0;
+    for (unsigned s = 0; s < in.slots.size(); s++)
+      if (home[t][s])
+        home_bits[t] |= SlotBit(s);
+  }
+}
+
 int STT_Solution::CalculateFullCost()
 {
+  state_version++;
+  PackHomeBits();
   total_cost_components = 0;
   total_cost_components_hard = 0;
   for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
   {
     total_cost_components += CalculateCostComponent(c_type);
-    total_cost_components_hard += CalculateCostComponentHard(c_type);
+    total_cost_components_hard += cost_components_hard[c_type];
   }
   CalculateCostPhased();
   return total_cost_components + cost_phased;
 }
 
+int STT_Solution::ApplyWeights()
+{
+  WeighComponents();
+  UpdateCostPhased();
+  return ReturnTotalCost();
+}
+
+void STT_Solution::WeighComponent(unsigned int c_type)
+{
+  cost_components_hard[c_type] = HardWeight(c_type) * violations_hard[c_type];
+  cost_components[c_type] = cost_components_hard[c_type] + violations_soft[c_type];
+}
+
+int STT_Solution::WeighComponents(int hard_weight, const array<int, N_CONSTRAINTS>& factors) const
+{
+  int total = 0;
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+    total += HardWeight(c_type, hard_weight, factors) * violations_hard[c_type] + violations_soft[c_type];
+  return total;
+}
+
+void STT_Solution::WeighComponents()
+{
+  total_cost_components = 0;
+  total_cost_components_hard = 0;
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+  {
+    WeighComponent(c_type);
+    total_cost_components += cost_components[c_type];
+    total_cost_components_hard += cost_components_hard[c_type];
+  }
+}
+
+int STT_Solution::LoadTimetable(const STT_Solution& st)
+{
+  // if both inputs share the same constraints, the arrays (violations and incremental data included) have the
+  // same layout and values, only the weights change
+  if (&st.in.Instance() != &in.Instance())
+  {
+    // e.g., st comes from the stage with the hard constraints only: the costs have to be calculated from scratch
+    opponent.CopyValues(st.opponent);
+    home.CopyValues(st.home);
+    match.CopyValues(st.match);
+    is_return_match.CopyValues(st.is_return_match);
+    last_best_solution = CalculateFullCost();
+    return last_best_solution;
+  }
+  if (this != &st)
+    memcpy(storage.data(), st.storage.data(), storage.size()*sizeof(uint64_t));
+  state_version++;
+  fa2_touched_count = st.fa2_touched_count;
+  same_phase_pairs = st.same_phase_pairs;
+  violated_count = st.violated_count;
+  last_best_solution = ApplyWeights();
+  return last_best_solution;
+}
+
 int STT_Solution::CalculateCostComponent(unsigned int c_type)
 {
-  int cost = 0;
+  if (c_type == CA3)
+    ResetCA3Data();
+  else if (c_type == FA2)
+    ResetFA2Data();
   for(unsigned int c = 0; c < in.ConstraintsVectorSize(c_type); c++)
   {
-      cost_single_constraints[c_type][c] = CalculateCostSingleConstraint(c_type, c);
-      cost += cost_single_constraints[c_type][c];
+      if (c_type == CA3)
+        SetViolation(c_type, c, CA3Violation(c));
+      else
+        SetViolation(c_type, c, c_type == FA2 ? FA2Violation(c) : CalculateViolationSingleConstraint(c_type, c));
   }
-  cost_components[c_type] = cost;
+  WeighComponent(c_type);
   return cost_components[c_type];
 }
 
 int STT_Solution::CalculateCostComponentHard(unsigned int c_type)
 {
-  int cost_hard = 0;
   for(unsigned int c = 0; c < in.ConstraintsVectorSize(c_type); c++)
   {  
       if(in.IsHard(c_type, c))
       {
-        cost_single_constraints[c_type][c] = CalculateCostSingleConstraint(c_type, c);
-        cost_hard += cost_single_constraints[c_type][c];
+        // CA3 and FA2 data are rebuilt by CalculateCostComponent
+        if (c_type == CA3)
+          SetViolation(c_type, c, CA3Violation(c));
+        else
+          SetViolation(c_type, c, c_type == FA2 ? FA2Violation(c) : CalculateViolationSingleConstraint(c_type, c));
       }
   }
-  cost_components_hard[c_type] = cost_hard;
+  WeighComponent(c_type);
   return cost_components_hard[c_type];
 }
 
+void STT_Solution::SetViolation(unsigned int c_type, unsigned int c, int violation)
+{
+  // the sums and the violated set are kept aligned with the stored violations (all zero in a new solution)
+  int old_violation = violations[c_type][c];
+  (in.IsHard(c_type, c) ? violations_hard : violations_soft)[c_type] += violation - old_violation;
+  violations[c_type][c] = violation;
+  if (old_violation <= 0 && violation > 0)
+  {
+    violated_types[violated_count] = c_type;
+    violated_constraints[violated_count] = c;
+    violated_position[c_type][c] = ++violated_count;
+  }
+  else if (old_violation > 0 && violation <= 0)
+  {
+    // the last element of the set takes the place of the removed one
+    unsigned i = violated_position[c_type][c] - 1;
+    violated_count--;
+    violated_types[i] = violated_types[violated_count];
+    violated_constraints[i] = violated_constraints[violated_count];
+    violated_position[violated_types[i]][violated_constraints[i]] = i + 1;
+    violated_position[c_type][c] = 0;
+  }
+}
+
+bool STT_Solution::SampleViolatedCell(STT_Random& rng, unsigned& t, unsigned& s) const
+{
+  if (violated_count == 0)
+    return false;
+  unsigned i = rng.Uniform<unsigned>(0, violated_count - 1);
+  ConstraintSpan teams = in.ConstraintTeams(violated_types[i], violated_constraints[i]), slots = in.ConstraintSlots(violated_types[i], violated_constraints[i]);
+  if (teams.empty() || slots.empty())
+    return false;
+  t = teams[rng.Uniform<size_t>(0, teams.size() - 1)];
+  s = slots[rng.Uniform<size_t>(0, slots.size() - 1)];
+  return true;
+}
+
 int STT_Solution::CalculateCostSingleConstraint(unsigned int c_type, unsigned int c) const
 {
-  int cost = 0;
+  return CalculateCostSingleConstraint(*this, c_type, c);
+}
+
+template <class State>
+int STT_Solution::CalculateCostSingleConstraint(const State& st, unsigned int c_type, unsigned int c) const
+{
+  return Weight(c_type, c) * CalculateViolationSingleConstraint(st, c_type, c);
+}
+
+template int STT_Solution::CalculateCostSingleConstraint<STT_Solution>(const STT_Solution& st, unsigned int c_type, unsigned int c) const;
+template int STT_Solution::CalculateCostSingleConstraint<STT_SolutionOverlay>(const STT_SolutionOverlay& st, unsigned int c_type, unsigned int c) const;
+
+int STT_Solution::CalculateViolationSingleConstraint(unsigned int c_type, unsigned int c) const
+{
+  return CalculateViolationSingleConstraint(*this, c_type, c);
+}
+
+// number of games of t1 against t2 in the slots of slots_mask, in the given mode from the point of view of t1
+// (match[t1][t2] is the slot of the game at the venue of t1, match[t2][t1] the one at the venue of t2)
+template <class State>
+static int PairGamesInSlots(const State& st, unsigned int t1, unsigned int t2, unsigned int mode, uint64_t slots_mask)
+{
+  if (t1 == t2)
+    return 0;
+  int games = 0;
+  if (mode == HOME || mode == ANY)
+    games += (slots_mask & SlotBit(st.Match(t1, t2))) != 0;
+  if (mode == AWAY || mode == ANY)
+    games += (slots_mask & SlotBit(st.Match(t2, t1))) != 0;
+  return games;
+}
+
+// slots in which t1 plays a game counted by CA3 constraint c (at most one game per slot)
+template <class State>
+static uint64_t CA3Games(const STT_Input& in, const State& st, unsigned int c, unsigned int t1)
+{
+  uint64_t games = 0;
+  for (auto t2 : in.team_group[in.constraints_CA3[c].team_group_2_index])
+  {
+    if (t2 == t1)
+      continue;
+    if (in.constraints_CA3[c].mode == HOME || in.constraints_CA3[c].mode == ANY)
+      games |= SlotBit(st.Match(t1, t2));
+    if (in.constraints_CA3[c].mode == AWAY || in.constraints_CA3[c].mode == ANY)
+      games |= SlotBit(st.Match(t2, t1));
+  }
+  return games;
+}
+
+// excess over [k_min, k_max] of the games in the k-slot windows starting at the slots first, ..., last
+static int CA3WindowsExcess(const CA3Spec& constraint, uint64_t games, int first, int last)
+{
+  uint64_t window = SlotsUpTo(constraint.k - 1);
+  int excess = 0;
+  for (int s = first; s <= last; s++)
+  {
+    int total = PopCount(games & (window << s));
+    excess += max(0, max(constraint.k_min - total, total - constraint.k_max));
+  }
+  return excess;
+}
+
+// variation of the excess when the games of a team change from old_games to new_games:
+// only the windows covering at least one changed slot are evaluated
+static int CA3DeltaExcess(const CA3Spec& constraint, int slots, uint64_t old_games, uint64_t new_games)
+{
+  uint64_t changed = old_games ^ new_games;
+  if (changed == 0)
+    return 0;
+  int first = max(0, LowestSlot(changed) - constraint.k + 1), last = min(HighestSlot(changed), slots - constraint.k);
+  return CA3WindowsExcess(constraint, new_games, first, last) - CA3WindowsExcess(constraint, old_games, first, last);
+}
+
+template <class State>
+int STT_Solution::CalculateViolationSingleConstraint(const State& st, unsigned int c_type, unsigned int c) const
+{
+  int violation = 0;
 
     if(c_type == CA1)
     {
+      uint64_t slots_mask = in.slot_group_mask[in.constraints_CA1[c].slot_group_index];
       for (auto t : in.team_group[in.constraints_CA1[c].team_group_index])
       {
         int games = 0;
-        for (auto s : in.slot_group[in.constraints_CA1[c].slot_group_index])
-        {
-          if (in.constraints_CA1[c].mode == HOME && home[t][s])
-            games++;
-          else if (in.constraints_CA1[c].mode == AWAY && !home[t][s])
-            games++;
-        }
-        cost += (in.constraints_CA1[c].hard ? stt_hard_weight*in.hard_weights[CA1] : 1) 
-                * in.constraints_CA1[c].penalty 
+        if (in.constraints_CA1[c].mode == HOME)
+          games = PopCount(st.HomeBits(t) & slots_mask);
+        else if (in.constraints_CA1[c].mode == AWAY)
+          games = PopCount(~st.HomeBits(t) & slots_mask);
+        violation += in.constraints_CA1[c].penalty 
                 * max(0, max(in.constraints_CA1[c].k_min - games, games - in.constraints_CA1[c].k_max));
       }
-      return cost;
+      return violation;
     }
     else if(c_type == CA2)
     {
+      uint64_t slots_mask = in.slot_group_mask[in.constraints_CA2[c].slot_group_index];
       for (auto t1 : in.team_group[in.constraints_CA2[c].team_group_1_index])
       {
         int games = 0;
         for (auto t2 : in.team_group[in.constraints_CA2[c].team_group_2_index])
-          for (auto s : in.slot_group[in.constraints_CA2[c].slot_group_index])
-          {
-            if (opponent[t1][s] != t2)
-              continue;
-            if (in.constraints_CA2[c].mode == HOME && home[t1][s])
-              games++;
-            else if (in.constraints_CA2[c].mode == AWAY && !home[t1][s])
-              games++;
-            else if (in.constraints_CA2[c].mode == ANY)
-              games++;
-          }
-        cost += (in.constraints_CA2[c].hard ? stt_hard_weight*in.hard_weights[CA2] : 1) 
-                * in.constraints_CA2[c].penalty 
+          games += PairGamesInSlots(st, t1, t2, in.constraints_CA2[c].mode, slots_mask);
+        violation += in.constraints_CA2[c].penalty 
                 * max(0, max(in.constraints_CA2[c].k_min - games, games - in.constraints_CA2[c].k_max));
       }
-      return cost;
+      return violation;
     }
     else if(c_type == CA3)
     {
+      int excess = 0;
       for (auto t1 : in.team_group[in.constraints_CA3[c].team_group_1_index])
-      {
-        vector<unsigned int> games(in.slots.size(), 0);
-        for (auto t2 : in.team_group[in.constraints_CA3[c].team_group_2_index])
-        {
-          for (size_t s = 0; s < in.slots.size(); s++)
-          {
-            if (opponent[t1][s] != t2)
-              continue;
-            if (in.constraints_CA3[c].mode == HOME && home[t1][s])
-              games[s]++;
-            else if (in.constraints_CA3[c].mode == AWAY && !home[t1][s])
-              games[s]++;
-            else if (in.constraints_CA3[c].mode == ANY)
-              games[s]++;
-          }
-        }
-        for (size_t s = 0; s + in.constraints_CA3[c].k - 1 < in.slots.size(); s++)
-        {
-          int total = 0;
-          for (int i = 0; i < in.constraints_CA3[c].k; i++)
-            total += games[s + i];
-          cost += (in.constraints_CA3[c].hard ? stt_hard_weight*in.hard_weights[CA3] : 1) 
-                  * in.constraints_CA3[c].penalty 
-                  * max(0, max(in.constraints_CA3[c].k_min - total, total - in.constraints_CA3[c].k_max));
-        }
-      }
-      return cost;
+        excess += CA3WindowsExcess(in.constraints_CA3[c], CA3Games(in, st, c, t1), 0, int(in.slots.size()) - in.constraints_CA3[c].k);
+      violation += in.constraints_CA3[c].penalty 
+              * excess;
+      return violation;
     }
     else if(c_type == CA4)
     {
+      uint64_t slots_mask = in.slot_group_mask[in.constraints_CA4[c].slot_group_index];
       if (in.constraints_CA4[c].mode2 == CA4Spec::GLOBAL)
       {
         int games = 0;
         for (auto t1 : in.team_group[in.constraints_CA4[c].team_group_1_index])
         {
           for (auto t2 : in.team_group[in.constraints_CA4[c].team_group_2_index])
-            for (auto s : in.slot_group[in.constraints_CA4[c].slot_group_index])
-            {
-              if (opponent[t1][s] != t2)
-                continue;
-              if (in.constraints_CA4[c].mode1 == HOME && home[t1][s])
-                games++;
-              else if (in.constraints_CA4[c].mode1 == AWAY && !home[t1][s])
-                games++;
-              else if (in.constraints_CA4[c].mode1 == ANY)
-                games++;
-            }
+            games += PairGamesInSlots(st, t1, t2, in.constraints_CA4[c].mode1, slots_mask);
         }
-        cost += (in.constraints_CA4[c].hard ? stt_hard_weight*in.hard_weights[CA4] : 1) 
-                * in.constraints_CA4[c].penalty 
+        violation += in.constraints_CA4[c].penalty 
                 * max(0, max(in.constraints_CA4[c].k_min - games, games - in.constraints_CA4[c].k_max));
       }
       else // (in.constraints_CA4[c].mode2 == CA4Spec::EVERY)
       {
-        for (auto s : in.slot_group[in.constraints_CA4[c].slot_group_index])
+        // games are first distributed on the slots they are played in (at most 64 slots, see SlotBit)
+        array<int, 64> games_in_slot{};
+        for (auto t1 : in.team_group[in.constraints_CA4[c].team_group_1_index])
         {
-          int games = 0;
-          for (auto t1 : in.team_group[in.constraints_CA4[c].team_group_1_index])
+          for (auto t2 : in.team_group[in.constraints_CA4[c].team_group_2_index])
           {
-            for (auto t2 : in.team_group[in.constraints_CA4[c].team_group_2_index])
-            {
-              if (opponent[t1][s] != t2)
-                continue;
-              if (in.constraints_CA4[c].mode1 == HOME && home[t1][s])
-                games++;
-              else if (in.constraints_CA4[c].mode1 == AWAY && !home[t1][s])
-                games++;
-              else if (in.constraints_CA4[c].mode1 == ANY)
-                games++;
-            }
+            if (t1 == t2)
+              continue;
+            if (in.constraints_CA4[c].mode1 == HOME || in.constraints_CA4[c].mode1 == ANY)
+              games_in_slot[st.Match(t1, t2)]++;
+            if (in.constraints_CA4[c].mode1 == AWAY || in.constraints_CA4[c].mode1 == ANY)
+              games_in_slot[st.Match(t2, t1)]++;
           }
-          cost += (in.constraints_CA4[c].hard ? stt_hard_weight*in.hard_weights[CA4] : 1) 
-                  * in.constraints_CA4[c].penalty 
+        }
+        for (auto s : in.slot_group[in.constraints_CA4[c].slot_group_index])
+        {
+          int games = games_in_slot[s];
+          violation += in.constraints_CA4[c].penalty 
                   * max(0, max(in.constraints_CA4[c].k_min - games, games - in.constraints_CA4[c].k_max));
         }
       }
-      return cost;
+      return violation;
     }
     else if(c_type == GA1)
     {
       int games = 0;
+      uint64_t slots_mask = in.slot_group_mask[in.constraints_GA1[c].slot_group_index];
       for (auto m : in.constraints_GA1[c].meeting_group)
-      {
-        for (auto s : in.slot_group[in.constraints_GA1[c].slot_group_index])
-        {
-          if (!home[m.first][s])
-            continue;
-          if (opponent[m.first][s] == m.second)
-            games++;
-        }
-      }
-      cost += (in.constraints_GA1[c].hard ? stt_hard_weight*in.hard_weights[GA1] : 1) 
-              * in.constraints_GA1[c].penalty 
+        games += PairGamesInSlots(st, m.first, m.second, HOME, slots_mask);
+      violation += in.constraints_GA1[c].penalty 
               * max(0, max(in.constraints_GA1[c].k_min - games, games - in.constraints_GA1[c].k_max));
       
-      return cost;
+      return violation;
     }
     else if(c_type == BR1)
     {
+      // a break at slot s > 0 depends on slots s - 1 and s: the pattern shifted by one gives, at bit s, the venue at slot s - 1
+      uint64_t slots_mask = in.slot_group_mask[in.constraints_BR1[c].slot_group_index] & ~SlotBit(0);
       for (auto t : in.team_group[in.constraints_BR1[c].team_group_index])
       {
+        uint64_t h = st.HomeBits(t), previous_h = h << 1;
         int breaks = 0;
-        for (auto s : in.slot_group[in.constraints_BR1[c].slot_group_index])
-        {
-          if (in.constraints_BR1[c].mode == HOME && s > 0 && home[t][s - 1] && home[t][s])
-            breaks++;
-          else if (in.constraints_BR1[c].mode == AWAY && s > 0 && !home[t][s - 1] && !home[t][s - 1])
-            breaks++;
-          else if (in.constraints_BR1[c].mode == ANY && s > 0 && home[t][s - 1] == home[t][s])
-            breaks++;
-        }
-        cost += (in.constraints_BR1[c].hard ? stt_hard_weight*in.hard_weights[BR1] : 1) 
-                * in.constraints_BR1[c].penalty 
+        if (in.constraints_BR1[c].mode == HOME)
+          breaks = PopCount(previous_h & h & slots_mask);
+        else if (in.constraints_BR1[c].mode == AWAY) // NOTE: only slot s - 1 is checked, as in the original slot by slot evaluation
+          breaks = PopCount(~previous_h & slots_mask);
+        else if (in.constraints_BR1[c].mode == ANY)
+          breaks = PopCount(~(previous_h ^ h) & slots_mask);
+        violation += in.constraints_BR1[c].penalty 
                 * max(0, breaks - in.constraints_BR1[c].k); 
       }
-      return cost;
+      return violation;
     }
     else if(c_type == BR2)
     {
       int breaks = 0;
+      uint64_t slots_mask = in.slot_group_mask[in.constraints_BR2[c].slot_group_index] & ~SlotBit(0);
       for (auto t : in.team_group[in.constraints_BR2[c].team_group_index])
       {
-          for (auto s : in.slot_group[in.constraints_BR2[c].slot_group_index])
-          {
-              // the only considered mode is ANY
-              if (s > 0 && home[t][s - 1] == home[t][s])
-                  breaks++;
-          }
+          // the only considered mode is ANY
+          uint64_t h = st.HomeBits(t);
+          breaks += PopCount(~((h << 1) ^ h) & slots_mask);
       }
-      cost += 
-             (in.constraints_BR2[c].hard ? stt_hard_weight*in.hard_weights[BR2] : 1) 
-             * in.constraints_BR2[c].penalty 
+      violation += 
+             in.constraints_BR2[c].penalty 
              * max(0, breaks - in.constraints_BR2[c].k);
       
-      return cost;
+      return violation;
     }
     else if(c_type == FA2)
     {
@@ -794,28 +1048,26 @@ int STT_Solution::CalculateCostSingleConstraint(unsigned int c_type, unsigned in
         for (size_t j = i + 1; j < in.team_group[in.constraints_FA2[c].team_group_index].size(); j++)
         {
           unsigned int t1 = in.team_group[in.constraints_FA2[c].team_group_index][i], t2 = in.team_group[in.constraints_FA2[c].team_group_index][j];
-          int home_games_t1 = 0, home_games_t2 = 0;
+          uint64_t slots_mask = in.slot_group_mask[in.constraints_FA2[c].slot_group_index];
+          uint64_t h1 = st.HomeBits(t1) & slots_mask, h2 = st.HomeBits(t2) & slots_mask;
           int current_home_games_difference = 0;
           int max_home_games_difference = 0;
           for (auto s : in.slot_group[in.constraints_FA2[c].slot_group_index])
           {
             // the only considered mode is HOME
-            home_games_t1 += home[t1][s];
-            home_games_t2 += home[t2][s];
-            current_home_games_difference = fabs(home_games_t1 - home_games_t2);
+            current_home_games_difference = abs(PopCount(h1 & SlotsUpTo(s)) - PopCount(h2 & SlotsUpTo(s)));
             if(current_home_games_difference > max_home_games_difference)
               max_home_games_difference = current_home_games_difference;
             // According to the documentation: each pair of teams in teams triggers a deviation equal to the largest difference in played home games more than intp for each slot in slots.
           }
           if(max_home_games_difference > in.constraints_FA2[c].k)
           {
-            cost += (in.constraints_FA2[c].hard ? stt_hard_weight*in.hard_weights[FA2] : 1)
-            * in.constraints_FA2[c].penalty
+            violation += in.constraints_FA2[c].penalty
             * max(0, max_home_games_difference - in.constraints_FA2[c].k);
           }
         }
       }
-      return cost;
+      return violation;
     }
     else if(c_type == SE1)
     {
@@ -824,28 +1076,137 @@ int STT_Solution::CalculateCostSingleConstraint(unsigned int c_type, unsigned in
         for (size_t j = i + 1; j < in.team_group[in.constraints_SE1[c].team_group_index].size(); j++)
         {
           unsigned int t1 = in.team_group[in.constraints_SE1[c].team_group_index][i], t2 = in.team_group[in.constraints_SE1[c].team_group_index][j];
-          int first = -1, second = -1;
-          for (size_t s = 0; s < in.slots.size(); s++)
-          {
-            // the only considered mode is SLOTS
-            if (opponent[t1][s] == t2 && first == -1)
-              first = s;
-            else if (opponent[t1][s] == t2)
-            {
-              second = s;
-              break;
-            }
-          }
+          // the only considered mode is SLOTS
+          int first = min(st.Match(t1, t2), st.Match(t2, t1)), second = max(st.Match(t1, t2), st.Match(t2, t1));
           int distance = second - (first + 1);
           // According to the documentation: each pair of teams in teams triggers a deviation equal to the largest difference in played home games more than intp over all time slots in slots.
-          cost += (in.constraints_SE1[c].hard ? stt_hard_weight*in.hard_weights[SE1] : 1) 
-                  * in.constraints_SE1[c].penalty 
+          violation += in.constraints_SE1[c].penalty 
                   * max(0, max(in.constraints_SE1[c].m_min - distance, distance - in.constraints_SE1[c].m_max));
         }
       }
-      return cost;
+      return violation;
+    }
+  return violation;
+}
+
+template int STT_Solution::CalculateViolationSingleConstraint<STT_Solution>(const STT_Solution& st, unsigned int c_type, unsigned int c) const;
+template int STT_Solution::CalculateViolationSingleConstraint<STT_SolutionOverlay>(const STT_SolutionOverlay& st, unsigned int c_type, unsigned int c) const;
+
+const vector<unsigned>& STT_Solution::InvolvedConstraints(const STT_SolutionOverlay& ov, unsigned int c_type) const
+{
+  //the constraints to be evaluated are the ones related to the cells written by the move
+  ov.involved_constraints.Clear(c_type);
+  for (const auto& cell : ov.ChangedCells())
+    ov.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, cell.first, cell.second));
+  return ov.involved_constraints.Constraints()[c_type];
+}
+
+int STT_Solution::CalculateDeltaCostComponent(const STT_SolutionOverlay& ov, unsigned int c_type) const
+{
+  if (c_type == FA2)
+    return CalculateDeltaCostFA2(ov);
+
+  int delta = 0;
+  if (c_type == CA3)
+  {
+    for (auto c : InvolvedConstraints(ov, c_type))
+      delta += Weight(CA3, c) * CalculateDeltaViolationSingleCA3(ov, c);
+    return delta;
+  }
+  for (auto c : InvolvedConstraints(ov, c_type))
+    delta += Weight(c_type, c) * (CalculateViolationSingleConstraint(ov, c_type, c) - violations[c_type][c]);
+  return delta;
+}
+
+bool STT_Solution::HardFeasible(const STT_SolutionOverlay& ov) const
+{
+  //the hard constraints not involved by the move keep their current violation, which must be zero
+  int involved_hard_violation = 0, hard_violation = 0;
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+  {
+    hard_violation += violations_hard[c_type];
+    for (auto c : InvolvedConstraints(ov, c_type))
+      if (in.IsHard(c_type, c))
+        involved_hard_violation += violations[c_type][c];
+  }
+  if (involved_hard_violation < hard_violation)
+    return false;
+
+  //the involved ones (collected above) are evaluated on the overlay, stopping at the first violation
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+  {
+    if (in.constraints_hard_indexes[c_type].empty())
+      continue;
+    if (c_type == FA2)
+    {
+      CollectFA2InvolvedTeams(ov);
+      for (auto c : in.constraints_hard_indexes[FA2])
+        if (violations[FA2][c] + CalculateDeltaViolationSingleFA2(ov, c) > 0)
+          return false;
+      continue;
+    }
+    if (c_type == CA3)
+    {
+      for (auto c : ov.involved_constraints.Constraints()[CA3])
+        if (in.IsHard(c_type, c) && violations[CA3][c] + CalculateDeltaViolationSingleCA3(ov, c) > 0)
+          return false;
+      continue;
+    }
+    for (auto c : ov.involved_constraints.Constraints()[c_type])
+      if (in.IsHard(c_type, c) && CalculateViolationSingleConstraint(ov, c_type, c) > 0)
+        return false;
+  }
+  return true;
+}
+
+bool STT_Solution::CalculateDeltaCostBounded(const STT_SolutionOverlay& ov, double threshold, int& delta, unsigned& evaluated) const
+{
+  //the involved constraints not evaluated yet (and the phased cost) can at most drop to zero: the move is surely
+  //rejected when the partial delta exceeds their cost by at least threshold (and by a positive amount)
+  int remaining = cost_phased;
+  delta = 0;
+  evaluated = 0;
+  CollectFA2InvolvedTeams(ov);
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+    if (c_type == FA2)
+    {
+      if (!ov.involved_teams.empty())
+        remaining += cost_components[FA2];
+    }
+    else for (auto c : InvolvedConstraints(ov, c_type))
+      remaining += Weight(c_type, c) * violations[c_type][c];
+  for (unsigned int pass = 0; pass < 2; pass++) //hard constraints in the first pass, soft ones in the second
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+    {
+      if (c_type == FA2)
+      {
+        if (!ov.involved_teams.empty())
+        {
+          remaining -= pass == 0 ? cost_components_hard[FA2] : cost_components[FA2] - cost_components_hard[FA2];
+          for (unsigned c = 0; c < in.constraints_FA2.size(); c++)
+            if (in.IsHard(FA2, c) == (pass == 0))
+            {
+              delta += Weight(FA2, c) * CalculateDeltaViolationSingleFA2(ov, c);
+              evaluated++;
+            }
+        }
+      }
+      else for (auto c : ov.involved_constraints.Constraints()[c_type])
+      {
+        if (in.IsHard(c_type, c) != (pass == 0))
+          continue;
+        remaining -= Weight(c_type, c) * violations[c_type][c];
+        evaluated++;
+        if (c_type == CA3)
+          delta += Weight(CA3, c) * CalculateDeltaViolationSingleCA3(ov, c);
+        else
+          delta += Weight(c_type, c) * (CalculateViolationSingleConstraint(ov, c_type, c) - violations[c_type][c]);
+      }
+      if (delta - remaining > 0 && delta - remaining >= threshold)
+        return false;
     }
-  return cost;
+  delta += CalculateDeltaCostPhased(ov);
+  return delta <= 0 || delta < threshold;
 }
 
 float STT_Solution::GreedyCalculateCost(unsigned int r) const
@@ -907,7 +1268,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
           amount += games / float(max(in.constraints_CA1[c].k_max, 1));
       }
     }
-    return (in.constraints_CA1[c].hard ? stt_hard_weight*in.hard_weights[CA1] : 1) * in.constraints_CA1[c].penalty * amount;
+    return (in.constraints_CA1[c].hard ? HardWeight(CA1) : 1) * in.constraints_CA1[c].penalty * amount;
   }
   else if (c_type == CA2)
   {
@@ -950,7 +1311,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
           amount += games / float(max(in.constraints_CA2[c].k_max, 1));
       }
     }
-    return (in.constraints_CA2[c].hard ? stt_hard_weight*in.hard_weights[CA2] : 1) * in.constraints_CA2[c].penalty * amount;
+    return (in.constraints_CA2[c].hard ? HardWeight(CA2) : 1) * in.constraints_CA2[c].penalty * amount;
   }
   else if (c_type == CA3)
   {
@@ -981,7 +1342,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
         amount += max(0, max(in.constraints_CA3[c].k_min - total, total - in.constraints_CA3[c].k_max));
       }
     }
-    return (in.constraints_CA3[c].hard ? stt_hard_weight*in.hard_weights[CA3] : 1) * in.constraints_CA3[c].penalty * amount;
+    return (in.constraints_CA3[c].hard ? HardWeight(CA3) : 1) * in.constraints_CA3[c].penalty * amount;
   }
   else if (c_type == CA4)
   {
@@ -1052,7 +1413,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
         amount += max(0, max(in.constraints_CA4[c].k_min - games, games - in.constraints_CA4[c].k_max));
       }
     }
-    return (in.constraints_CA4[c].hard ? stt_hard_weight*in.hard_weights[CA4] : 1) * in.constraints_CA4[c].penalty * amount;
+    return (in.constraints_CA4[c].hard ? HardWeight(CA4) : 1) * in.constraints_CA4[c].penalty * amount;
   }
   else if(c_type == GA1)
   {
@@ -1088,7 +1449,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
       else if (games >= in.constraints_GA1[c].k_min) // this is just a greedy measure
         amount += games / float(max(in.constraints_GA1[c].k_max, 1));
     }
-    return (in.constraints_GA1[c].hard ? stt_hard_weight*in.hard_weights[GA1] : 1) * in.constraints_GA1[c].penalty * amount;
+    return (in.constraints_GA1[c].hard ? HardWeight(GA1) : 1) * in.constraints_GA1[c].penalty * amount;
   }
   else if(c_type == BR1)
   {
@@ -1118,7 +1479,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
         amount += breaks / float(max(in.constraints_BR1[c].k, 1));
       }
     }
-    return (in.constraints_BR1[c].hard ? stt_hard_weight*in.hard_weights[BR1] : 1) * in.constraints_BR1[c].penalty * amount;
+    return (in.constraints_BR1[c].hard ? HardWeight(BR1) : 1) * in.constraints_BR1[c].penalty * amount;
   }
   else if(c_type == BR2)
   {
@@ -1145,7 +1506,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
       // this is just a greedy measure for keeping them minimal
       amount += breaks / float(max(in.constraints_BR2[c].k, 1));
     }
-    return (in.constraints_BR2[c].hard ? stt_hard_weight*in.hard_weights[BR2] : 1) * in.constraints_BR2[c].penalty * amount;
+    return (in.constraints_BR2[c].hard ? HardWeight(BR2) : 1) * in.constraints_BR2[c].penalty * amount;
   }
   else if (c_type == FA2)
   {
@@ -1179,7 +1540,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
         }
       }
     }
-    return (in.constraints_FA2[c].hard ? stt_hard_weight*in.hard_weights[FA2] : 1) * in.constraints_FA2[c].penalty * amount;
+    return (in.constraints_FA2[c].hard ? HardWeight(FA2) : 1) * in.constraints_FA2[c].penalty * amount;
   }
   else if (c_type == SE1)
   {
@@ -1221,7 +1582,7 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
         }
       }
     }
-    return (in.constraints_SE1[c].hard ? stt_hard_weight*in.hard_weights[SE1] : 1) * in.constraints_SE1[c].penalty * amount;
+    return (in.constraints_SE1[c].hard ? HardWeight(SE1) : 1) * in.constraints_SE1[c].penalty * amount;
   }
   
   return std::numeric_limits<float>::infinity();
@@ -1230,144 +1591,262 @@ float STT_Solution::GreedyCalculateCostSingleConstraint(Constraints::ConstraintT
 int STT_Solution::CalculateCostPhased()
 {
     //qui possiamo fare che ogni coppia di partite (andata e ritorno) che si trovano nella stessa fase è una violazione
-    int cost = 0;
-    
-    if(in.phased)
+    same_phase_pairs = 0;
+    for(unsigned int i = 0; i < in.teams.size()-1; i++)
     {
-      for(unsigned int i = 0; i < in.teams.size()-1; i++)
+      for(unsigned int j = i+1; j < in.teams.size(); j++)
       {
-        for(unsigned int j = i+1; j < in.teams.size(); j++)
+        if(SamePhase(match[i][j], match[j][i]))
         {
-          if(SamePhase(match[i][j], match[j][i]))
-          {
-            cost+=stt_phased_weight*2; //in order to get the same value of the online validator of the ITC2021 competition, I count it twice 
-          }
+          same_phase_pairs++;
         }
       }
     }
-    cost_phased = cost;
+    return UpdateCostPhased();
+}
+
+int STT_Solution::UpdateCostPhased()
+{
+    if(in.phased)
+      cost_phased = stt_phased_weight*2*same_phase_pairs; //in order to get the same value of the online validator of the ITC2021 competition, I count it twice 
+    else
+      cost_phased = 0;
     return cost_phased;
 }
 
-void STT_Solution::UpdateSelectionedCostsConstraints(vector<vector<unsigned>> involved_constraints)
+int STT_Solution::CalculateDeltaCostPhased(const STT_SolutionOverlay& ov) const
+{
+  int delta = 0;
+  if(in.phased)
+  {
+    for (const auto& m : ov.ChangedMatches())
+    {
+      unsigned i = m.first, j = m.second;
+      if (j < i && ov.IsMatchChanged(j, i)) //the pair has already been considered as (j, i)
+        continue;
+      if (SamePhase(ov.Match(i,j), ov.Match(j,i)))
+        delta += stt_phased_weight*2;
+      if (SamePhase(match[i][j], match[j][i]))
+        delta -= stt_phased_weight*2;
+    }
+  }
+  return delta;
+}
+
+void STT_Solution::UpdateSelectionedCostsConstraints(const vector<vector<unsigned>>& involved_constraints)
 {
   //APPLICO le funzioni di costo alle constraints di tipo CA1
-  int delta, delta_hard, new_cost, old_cost;
+  int new_violation;
   for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
   {
     if(c_type!=FA2) //NON APPLICO QUESTO CALCOLO PER FA2, CHE ESEGUO SEPARATAMENTE
     {
-      delta = 0;
-      delta_hard = 0;
       for(unsigned int c = 0; c < involved_constraints[c_type].size(); c++)
       {
-        old_cost = cost_single_constraints[c_type][involved_constraints[c_type][c]];
-        new_cost = CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), involved_constraints[c_type][c]);
-        delta = delta - old_cost + new_cost;
-        if(in.IsHard(c_type, involved_constraints[c_type][c]))
-          delta_hard = delta_hard - old_cost + new_cost;
-        cost_single_constraints[c_type][involved_constraints[c_type][c]] = new_cost;
+        if (c_type == CA3)
+          new_violation = UpdateCA3Constraint(involved_constraints[c_type][c]);
+        else
+          new_violation = CalculateViolationSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), involved_constraints[c_type][c]);
+        SetViolation(c_type, involved_constraints[c_type][c], new_violation);
       } 
-      cost_components[c_type] = cost_components[c_type] + delta;
-      cost_components_hard[c_type] = cost_components_hard[c_type] + delta_hard;
-      total_cost_components = total_cost_components + delta;
-      total_cost_components_hard = total_cost_components_hard + delta_hard;
     }
   }
 
-  //per adesso FA2 lo ricalcoliamo sempre per completo, visto che quando è presente riguarda sempre tutti i team e tutti gli slots.
-  //TO DO per una prossima fase: gestire anche FA2 solo per involved_constraints
-  //Questi tre forse ci conviene farlo anche per BR2 e SE1, visto che ce n'è al più uno solo per istanza
-  total_cost_components = total_cost_components - cost_components[FA2];
-  total_cost_components_hard = total_cost_components_hard - cost_components_hard[FA2];
-  CalculateCostComponent(FA2);
-  CalculateCostComponentHard(FA2);
-  total_cost_components = total_cost_components + cost_components[FA2];
-  total_cost_components_hard = total_cost_components_hard + cost_components_hard[FA2];
+  //FA2 riguarda di solito tutti i team e tutti gli slots: lo aggiorniamo in modo incrementale
+  //solo per i team il cui pattern casa/trasferta è cambiato (vedi UpdateFA2Costs)
+  UpdateFA2Costs();
+
+  //the weighted costs are derived from the violations
+  WeighComponents();
 }
 
-//versione unsigned
-vector<unsigned> STT_Solution::getInvolvedConstraints(Constraints::ConstraintType c_type, unsigned t1, unsigned t2, unsigned s) const
+// ***************************************************************************************
+// ************** INCREMENTAL EVALUATION OF CA3                        *******************
+// ***************************************************************************************
+// For each CA3 constraint the slots in which each team of its first group plays a counted
+// game are stored as a bit mask, together with the excess summed over all the k-slot windows;
+// when the games of a team change only the windows covering the changed slots are evaluated.
+
+void STT_Solution::ResetCA3Data()
 {
-  vector<unsigned> involved_constraints(0,0);
-  bool already_added;
-  for (unsigned c : in.team_slot_constraints[c_type][t1][s])
+  for (unsigned c = 0; c < in.constraints_CA3.size(); c++)
   {
-    involved_constraints.push_back(c);
+    const vector<unsigned>& team_group = in.team_group[in.constraints_CA3[c].team_group_1_index];
+    ca3_excess[c] = 0;
+    for (unsigned i = 0; i < team_group.size(); i++)
+    {
+      ca3_games[c][i] = CA3Games(in, *this, c, team_group[i]);
+      ca3_excess[c] += CA3WindowsExcess(in.constraints_CA3[c], ca3_games[c][i], 0, int(in.slots.size()) - in.constraints_CA3[c].k);
+    }
   }
+}
 
-  for (unsigned c : in.team_slot_constraints[c_type][t2][s])
+int STT_Solution::UpdateCA3Constraint(unsigned int c)
+{
+  const vector<unsigned>& team_group = in.team_group[in.constraints_CA3[c].team_group_1_index];
+  for (unsigned i = 0; i < team_group.size(); i++)
   {
-    //al secondo giro, evito di aggiungere quelle che avevo già aggiunto per [t1][s]
-    already_added = false;
-    for(unsigned i = 0; i < involved_constraints.size(); i++)
-      if(involved_constraints[i] == c)
-      {
-        already_added = true;
-        break;
-      }
-    if(!already_added)
-      involved_constraints.push_back(c);
+    uint64_t games = CA3Games(in, *this, c, team_group[i]);
+    ca3_excess[c] += CA3DeltaExcess(in.constraints_CA3[c], in.slots.size(), ca3_games[c][i], games);
+    ca3_games[c][i] = games;
   }
-  return involved_constraints;
+  return CA3Violation(c);
+}
+
+int STT_Solution::CalculateDeltaViolationSingleCA3(const STT_SolutionOverlay& ov, unsigned int c) const
+{
+  // only the teams with a cell written by the move can change their games
+  int delta_excess = 0;
+  for (auto t : ov.ChangedTeams())
+  {
+    int i = in.CA3_team_position[c][t];
+    if (i >= 0)
+      delta_excess += CA3DeltaExcess(in.constraints_CA3[c], in.slots.size(), ca3_games[c][i], CA3Games(in, ov, c, t));
+  }
+  return in.constraints_CA3[c].penalty * delta_excess;
+}
+
+// ***************************************************************************************
+// ************** INCREMENTAL EVALUATION OF FA2                        *******************
+// ***************************************************************************************
+// For each FA2 constraint the prefix home games of the teams of its group are stored,
+// together with the excess of each pair; when the home pattern of a team changes only
+// its prefix and the pairs it belongs to are recomputed.
+
+template <class State>
+static void FA2HomeGames(const State& st, const vector<unsigned>& slot_group, uint64_t slots_mask, unsigned t, int* home_games)
+{
+  // the only considered mode is HOME
+  uint64_t h = st.HomeBits(t) & slots_mask;
+  for (unsigned k = 0; k < slot_group.size(); k++)
+    home_games[k] = PopCount(h & SlotsUpTo(slot_group[k]));
 }
 
-//versione vettoriale
-vector<unsigned> STT_Solution::getInvolvedConstraints(Constraints::ConstraintType c_type, vector<unsigned> involved_teams, vector<unsigned> involved_slots) const
+static int FA2PairExcess(const int* home_games_t1, const int* home_games_t2, unsigned m, int k)
 {
-  vector<unsigned> involved_constraints(0,0);
-  bool already_added;
+  int max_home_games_difference = 0;
+  for (unsigned s = 0; s < m; s++)
+    max_home_games_difference = max(max_home_games_difference, abs(home_games_t1[s] - home_games_t2[s]));
+  return max(0, max_home_games_difference - k);
+}
 
-  for(unsigned t = 0; t < involved_teams.size(); t++)
-    for(unsigned s = 0; t < involved_slots.size(); s++)
-      for (unsigned c : in.team_slot_constraints[c_type][involved_teams[t]][involved_slots[s]])
+void STT_Solution::ResetFA2Data()
+{
+  for (unsigned c = 0; c < in.constraints_FA2.size(); c++)
+  {
+    const vector<unsigned>& team_group = in.team_group[in.constraints_FA2[c].team_group_index];
+    unsigned g = team_group.size(), m = in.slot_group[in.constraints_FA2[c].slot_group_index].size();
+    for (unsigned i = 0; i < g; i++)
+      FA2HomeGames(*this, in.slot_group[in.constraints_FA2[c].slot_group_index], in.slot_group_mask[in.constraints_FA2[c].slot_group_index], team_group[i], fa2_home_games[c] + i*m);
+    fa2_excess[c] = 0;
+    for (unsigned i = 0; i < g; i++)
+      for (unsigned j = i + 1; j < g; j++)
       {
-        if(s == 0 && t == 0)
-          involved_constraints.push_back(c);
-        else
-        {
-          //al secondo giro, evito di aggiungere quelle che avevo già aggiunto per [t1][s]
-          already_added = false;
-          for(unsigned i = 0; i < involved_constraints.size(); i++)
-            if(involved_constraints[i] == c)
-            {
-              already_added = true;
-              break;
-            }
-          if(!already_added)
-            involved_constraints.push_back(c);
-        }
+        fa2_pair_excess[c][i*g + j] = fa2_pair_excess[c][j*g + i] = FA2PairExcess(fa2_home_games[c] + i*m, fa2_home_games[c] + j*m, m, in.constraints_FA2[c].k);
+        fa2_excess[c] += fa2_pair_excess[c][i*g + j];
       }
+  }
+  for (unsigned k = 0; k < fa2_touched_count; k++)
+    fa2_team_touched[fa2_touched_teams[k]] = false;
+  fa2_touched_count = 0;
+}
 
-  return involved_constraints;
+void STT_Solution::UpdateFA2Team(unsigned int c, unsigned int i, const int* home_games)
+{
+  unsigned g = in.team_group[in.constraints_FA2[c].team_group_index].size(), m = in.slot_group[in.constraints_FA2[c].slot_group_index].size();
+  copy(home_games, home_games + m, fa2_home_games[c] + i*m);
+  for (unsigned j = 0; j < g; j++)
+    if (j != i)
+    {
+      int excess = FA2PairExcess(fa2_home_games[c] + i*m, fa2_home_games[c] + j*m, m, in.constraints_FA2[c].k);
+      fa2_excess[c] += excess - fa2_pair_excess[c][i*g + j];
+      fa2_pair_excess[c][i*g + j] = fa2_pair_excess[c][j*g + i] = excess;
+    }
 }
 
-void STT_Solution::UpdateLocalCostsDeleteMatch(unsigned t1, unsigned t2, unsigned old_r)
+void STT_Solution::UpdateFA2Costs()
 {
-    vector<unsigned> involved_teams(0,0);
-    vector<unsigned> involved_slots(0,0);
-    involved_teams.push_back(t1);
-    involved_teams.push_back(t2);
-    involved_slots.push_back(old_r);
-      
-    //CA1
-    vector<unsigned> involved_constraints = getInvolvedConstraints(CA1, t1, t2, old_r);
+  array<int, 64> home_games; //the slot groups have at most 64 slots (see SlotBit)
+  for (unsigned k = 0; k < fa2_touched_count; k++)
+  {
+    unsigned t = fa2_touched_teams[k];
+    for (auto c : in.TeamConstraints(FA2, t))
+    {
+      unsigned m = in.slot_group[in.constraints_FA2[c].slot_group_index].size();
+      FA2HomeGames(*this, in.slot_group[in.constraints_FA2[c].slot_group_index], in.slot_group_mask[in.constraints_FA2[c].slot_group_index], t, home_games.data());
+      unsigned i = in.FA2_team_position[c][t];
+      if (!equal(home_games.begin(), home_games.begin() + m, fa2_home_games[c] + i*m))
+        UpdateFA2Team(c, i, home_games.data());
+    }
+    fa2_team_touched[t] = false;
+  }
+  fa2_touched_count = 0;
 
+  for (unsigned c = 0; c < in.constraints_FA2.size(); c++)
+    SetViolation(FA2, c, FA2Violation(c));
+}
 
+void STT_Solution::CollectFA2InvolvedTeams(const STT_SolutionOverlay& ov) const
+{
+  // the teams whose home pattern is changed by the move
+  vector<unsigned>& involved_teams = ov.involved_teams;
+  involved_teams.clear();
+  for (const auto& cell : ov.ChangedCells())
+    if (ov.Home(cell.first, cell.second) != home[cell.first][cell.second])
+      involved_teams.push_back(cell.first);
+  sort(involved_teams.begin(), involved_teams.end());
+  involved_teams.erase(unique(involved_teams.begin(), involved_teams.end()), involved_teams.end());
+  if (ov.involved_home_games.size() < in.teams.size())
+    ov.involved_home_games.resize(in.teams.size());
 }
 
-void STT_Solution::UpdateLocalCostsInsertMatch(unsigned t1, unsigned t2, unsigned r)
+int STT_Solution::CalculateDeltaViolationSingleFA2(const STT_SolutionOverlay& ov, unsigned int c) const
 {
-  //CA1
-  vector<unsigned> involved_constraints = getInvolvedConstraints(CA1, t1, t2, r);
+  vector<vector<int>>& involved_home_games = ov.involved_home_games;
+  vector<int>& involved_position = ov.involved_position;
+  const vector<unsigned>& slot_group = in.slot_group[in.constraints_FA2[c].slot_group_index];
+  unsigned g = in.team_group[in.constraints_FA2[c].team_group_index].size(), m = slot_group.size();
+  unsigned n_changed = 0;
+  involved_position.assign(g, -1);
+  for (auto t : ov.involved_teams)
+  {
+    int i = in.FA2_team_position[c][t];
+    if (i < 0)
+      continue;
+    involved_home_games[n_changed].resize(m);
+    FA2HomeGames(ov, slot_group, in.slot_group_mask[in.constraints_FA2[c].slot_group_index], t, involved_home_games[n_changed].data());
+    if (!equal(involved_home_games[n_changed].begin(), involved_home_games[n_changed].end(), fa2_home_games[c] + i*m))
+      involved_position[i] = n_changed++;
+  }
+  if (n_changed == 0)
+    return 0;
+
+  int delta_excess = 0;
+  for (unsigned i = 0; i < g; i++)
+  {
+    if (involved_position[i] < 0)
+      continue;
+    for (unsigned j = 0; j < g; j++)
+    {
+      // the pairs of two changed teams are considered only once
+      if (j == i || (involved_position[j] >= 0 && j < i))
+        continue;
+      const int* home_games_j = involved_position[j] >= 0 ? involved_home_games[involved_position[j]].data() : fa2_home_games[c] + j*m;
+      delta_excess += FA2PairExcess(involved_home_games[involved_position[i]].data(), home_games_j, m, in.constraints_FA2[c].k) - fa2_pair_excess[c][i*g + j];
+    }
+  }
+  return in.constraints_FA2[c].penalty * delta_excess;
 }
 
-void STT_Solution::RecalculateConstraintsForTeamsMatches(vector<unsigned> involved_teams, vector<unsigned> involved_matches)
+int STT_Solution::CalculateDeltaCostFA2(const STT_SolutionOverlay& ov) const
 {
-  //costo prima del ricalcolo
-  
-  //CA1
-  vector<unsigned> involved_constraints = getInvolvedConstraints(CA1, involved_teams, involved_matches);
+  int delta = 0;
+  CollectFA2InvolvedTeams(ov);
+  if (ov.involved_teams.empty())
+    return 0;
+  for (unsigned c = 0; c < in.constraints_FA2.size(); c++)
+    delta += Weight(FA2, c) * CalculateDeltaViolationSingleFA2(ov, c);
+  return delta;
 }
 
 bool STT_Solution::SamePhase(unsigned int r1, unsigned int r2) const
@@ -1388,6 +1867,7 @@ void STT_Solution::UpdateMoveCounterAndBestSolution(int new_cost)
     last_best_counter = move_counter;
   }
   move_counter++;
+  state_version++;
 }
 
 void STT_Solution::DisplayOFIfNeeded()
@@ -1413,6 +1893,117 @@ void STT_Solution::DisplayOFIfNeeded()
   
 }
 
+// ***************************************************************************************
+// ************** METHODS FOR STT_InvolvedConstraints                  *******************
+// ***************************************************************************************
+
+STT_InvolvedConstraints::STT_InvolvedConstraints(const STT_Input& in)
+  : in(in), epoch(0)
+{}
+
+void STT_InvolvedConstraints::Clear()
+{
+  NewEpoch();
+  for (auto& c : constraints)
+    c.clear();
+}
+
+void STT_InvolvedConstraints::Clear(unsigned int c_type)
+{
+  NewEpoch();
+  constraints[c_type].clear();
+}
+
+void STT_InvolvedConstraints::NewEpoch()
+{
+  if (stamp.empty()) // first use: the buffers are allocated lazily, so that copying a solution does not allocate them
+  {
+    stamp.resize(N_CONSTRAINTS);
+    constraints.resize(N_CONSTRAINTS);
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+      stamp[c_type].resize(in.ConstraintsVectorSize(c_type), 0);
+  }
+  epoch++;
+  if (epoch == 0) // the stamps wrapped around, the old ones must be cleared
+  {
+    for (auto& s : stamp)
+      fill(s.begin(), s.end(), 0);
+    epoch = 1;
+  }
+}
+
+// ***************************************************************************************
+// ************** METHODS FOR STT_SolutionOverlay                      *******************
+// ***************************************************************************************
+
+void STT_SolutionOverlay::Reset()
+{
+  if (cell_epoch.empty()) // first use: the overlay is allocated lazily
+  {
+    teams = in.teams.size();
+    slots = in.slots.size();
+    cell_epoch.resize(teams*slots, 0);
+    cell_opponent.resize(teams*slots);
+    cell_home.resize(teams*slots);
+    match_epoch.resize(teams*teams, 0);
+    match_slot.resize(teams*teams);
+    team_epoch.resize(teams, 0);
+    team_home_bits.resize(teams);
+  }
+  epoch++;
+  if (epoch == 0) // the stamps wrapped around, the old ones must be cleared
+  {
+    fill(cell_epoch.begin(), cell_epoch.end(), 0);
+    fill(match_epoch.begin(), match_epoch.end(), 0);
+    fill(team_epoch.begin(), team_epoch.end(), 0);
+    epoch = 1;
+  }
+  changed_cells.clear();
+  changed_matches.clear();
+  changed_teams.clear();
+  simulated_move.clear();
+}
+
+void STT_SolutionOverlay::UpdateStateCell(unsigned t1, unsigned r, unsigned t2, bool home_game)
+{
+  if (home_game)
+  {
+    if (match_epoch[t1*teams + t2] != epoch)
+    {
+      match_epoch[t1*teams + t2] = epoch;
+      changed_matches.push_back(make_pair(t1, t2));
+    }
+    match_slot[t1*teams + t2] = r;
+  }
+  if (cell_epoch[t1*slots + r] != epoch)
+  {
+    cell_epoch[t1*slots + r] = epoch;
+    changed_cells.push_back(make_pair(t1, r));
+  }
+  cell_home[t1*slots + r] = home_game;
+  cell_opponent[t1*slots + r] = t2;
+  if (team_epoch[t1] != epoch)
+  {
+    team_epoch[t1] = epoch;
+    team_home_bits[t1] = st.home_bits[t1];
+    changed_teams.push_back(t1);
+  }
+  if (home_game)
+    team_home_bits[t1] |= SlotBit(r);
+  else
+    team_home_bits[t1] &= ~SlotBit(r);
+}
+
+void STT_SolutionOverlay::UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1, bool rev2)
+{
+  UpdateMatchesOf(*this, t1, t2, r, rev1, rev2);
+}
+
+void STT_SolutionOverlay::InternalMakeSwapHomes(unsigned t1, unsigned t2)
+{
+  InternalMakeSwapHomesOf(*this, t1, t2);
+}
+
 // ***************************************************************************************
 // ************** METHODS FOR NEIGHBORHOOD 1: swap homes              ********************
 // ***************************************************************************************
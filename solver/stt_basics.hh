@@ -2,9 +2,146 @@
 
 #include "stt_data.hh"
 #include <iostream>
+#include <cstring>
+#include <random>
 #include <easylocal.hh>
 using namespace EasyLocal::Core;
 
+class STT_Solution;
+
+// Random number generator of a search: the solution manager, the neighborhood explorers and the solutions draw from
+// the one they are given instead of the global Random of EasyLocal, so that searches in parallel share no state and
+// each of them is reproduced by its own seed
+class STT_Random
+{
+public:
+    explicit STT_Random(unsigned seed = 0) : generator(seed) {}
+    void SetSeed(unsigned seed) { generator.seed(seed); }
+    template <typename T>
+    T Uniform(T a, T b) // in [a, b], as Random::Uniform
+    {
+      if constexpr (is_floating_point<T>::value)
+        return uniform_real_distribution<T>(a, b)(generator);
+      else
+        return uniform_int_distribution<T>(a, b)(generator);
+    }
+    mt19937& Generator() { return generator; }
+private:
+    mt19937 generator;
+};
+
+// Views on the arrays of a solution, which are all carved out of a single block of memory owned by the
+// solution (see STT_Solution::BindStorage); the views do not own the memory and are never copied between solutions.
+template <typename T>
+class STT_Matrix // rows of the same length
+{
+public:
+    STT_Matrix() : data(nullptr), rows(0), columns(0) {}
+    STT_Matrix(T* data, unsigned rows, unsigned columns) : data(data), rows(rows), columns(columns) {}
+    T* operator[](unsigned r) { return data + r*columns; }
+    const T* operator[](unsigned r) const { return data + r*columns; }
+    bool operator==(const STT_Matrix& m) const { return rows == m.rows && columns == m.columns && equal(data, data + rows*columns, m.data); }
+    void CopyValues(const STT_Matrix& m) { copy(m.data, m.data + rows*columns, data); } // m must have the same shape
+private:
+    T* data;
+    unsigned rows, columns;
+};
+
+template <typename T>
+class STT_RaggedMatrix // rows of different lengths: row r is data[offsets[r]], ..., data[offsets[r + 1] - 1]
+{
+public:
+    STT_RaggedMatrix() : data(nullptr), offsets(nullptr) {}
+    STT_RaggedMatrix(T* data, const unsigned* offsets) : data(data), offsets(offsets) {}
+    T* operator[](unsigned r) { return data + offsets[r]; }
+    const T* operator[](unsigned r) const { return data + offsets[r]; }
+private:
+    T* data;
+    const unsigned* offsets;
+};
+
+// Sets of constraint indexes (one for each constraint type) used by the MakeMove functions to collect the
+// constraints to be recomputed, and by the overlay for the ones touched by the simulated move; membership is
+// tracked by epoch stamps, so that adding is O(1) and clearing does not touch the stamps (nor allocate memory
+// once the buffers have grown)
+class STT_InvolvedConstraints
+{
+public:
+    STT_InvolvedConstraints(const STT_Input& in);
+    void Clear(); //starts a new (empty) collection
+    void Clear(unsigned int c_type); //as above, for the type c_type only (the sets of the other types are kept, but they must not be added to)
+    void Add(unsigned int c_type, unsigned int c)
+    {
+        if (stamp[c_type][c] != epoch)
+        {
+            stamp[c_type][c] = epoch;
+            constraints[c_type].push_back(c);
+        }
+    }
+    void Add(unsigned int c_type, ConstraintSpan cs)
+    {
+        for (auto c : cs)
+            Add(c_type, c);
+    }
+    const vector<vector<unsigned>>& Constraints() const { return constraints; } //usage: Constraints()[c_type]
+private:
+    void NewEpoch(); //no constraint is marked as collected after it (the stamps are not touched)
+    const STT_Input& in;
+    unsigned epoch; // a constraint belongs to the current collection iff its stamp is equal to epoch
+    vector<vector<unsigned>> stamp;
+    vector<vector<unsigned>> constraints;
+};
+
+// A tentative move applied "on top" of a solution: only the cells (and matches) written by the move are stored,
+// all the others are read through from the underlying solution, which is never modified.
+// It provides the same read accessors and update methods of STT_Solution, so that both the move execution
+// and the cost kernels can be applied to either of them.
+// Delta costs (and FeasibleMove) are computed on the overlay, so a rejected move never writes the solution:
+// there is nothing to roll back, and the solution keeps no undo journal.
+class STT_SolutionOverlay
+{
+public:
+    STT_SolutionOverlay(const STT_Solution& st);
+    void Reset(); //starts a new (empty) simulation on the current state of the underlying solution
+    unsigned Opponent(unsigned t, unsigned s) const;
+    bool Home(unsigned t, unsigned s) const;
+    uint64_t HomeBits(unsigned t) const;
+    unsigned Match(unsigned t1, unsigned t2) const;
+    bool IsMatchChanged(unsigned t1, unsigned t2) const { return match_epoch[t1*teams + t2] == epoch; }
+
+    //needed by makemove functions (same semantics of the STT_Solution ones)
+    void UpdateStateCell(unsigned t1, unsigned r, unsigned t2, bool home_game);
+    void UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1 = false, bool rev2 = false);
+    void InternalMakeSwapHomes(unsigned t1, unsigned t2);
+
+    const vector<pair<unsigned, unsigned>>& ChangedCells() const { return changed_cells; } // (team, slot) cells written by the move
+    const vector<pair<unsigned, unsigned>>& ChangedMatches() const { return changed_matches; } // (home team, away team) entries of match written by the move
+    const vector<unsigned>& ChangedTeams() const { return changed_teams; } // teams with at least one cell written by the move
+    mutable STT_InvolvedConstraints involved_constraints; //scratch used while computing the delta costs
+    mutable vector<unsigned> involved_teams; //scratch for FA2: teams whose home pattern is changed by the move
+    mutable vector<vector<int>> involved_home_games; //scratch for FA2: their new prefix home games
+    mutable vector<int> involved_position; //scratch for FA2: position in involved_teams of each team of the group (-1 if not changed)
+    //the simulation is reused while the same move is simulated on the same state: a move is identified by a key
+    //holding all the data read to simulate it, and a state by the state_version of the solution
+    unsigned long int simulated_version;
+    vector<unsigned> simulated_move; //key of the simulated move (empty if the simulation is not of a whole move)
+    vector<unsigned> move_key; //scratch for the key of the next move to simulate
+    const STT_Input& in;
+private:
+    const STT_Solution& st;
+    unsigned teams, slots;
+    unsigned epoch; // a cell belongs to the current simulation iff its stamp is equal to epoch
+    vector<unsigned> cell_epoch, cell_opponent;
+    vector<bool> cell_home;
+    vector<unsigned> match_epoch, match_slot;
+    vector<unsigned> team_epoch;
+    vector<uint64_t> team_home_bits;
+    vector<pair<unsigned, unsigned>> changed_cells;
+    vector<pair<unsigned, unsigned>> changed_matches;
+    vector<unsigned> changed_teams;
+};
+
+
 class STT_Solution
 {
     friend ostream& operator<<(ostream& os, const STT_Solution& st);
@@ -14,94 +151,94 @@ class STT_Solution
     // 1. being a compact double round-robin each team plays at each time slot
 public:
     STT_Solution(const STT_Input& in,  bool display_OF = false) 
-        : in(in), opponent(in.teams.size(), vector<unsigned int>(in.slots.size())), home(in.teams.size(), 
-        vector<bool>(in.slots.size())), match(in.teams.size(), vector<unsigned int>(in.teams.size())), is_return_match(in.teams.size(), 
-        vector<bool>(in.slots.size())), cost_components(N_CONSTRAINTS,0), cost_components_hard(N_CONSTRAINTS,0), 
-        cost_single_constraints(N_CONSTRAINTS, vector<int>(0)), total_cost_components(0), 
-        total_cost_components_hard(0), cost_phased(0), stt_hard_weight(in.initial_stt_hard_weight), 
+        : in(in), violated_count(0), total_cost_components(0), 
+        total_cost_components_hard(0), cost_phased(0), same_phase_pairs(0), fa2_touched_count(0), stt_hard_weight(in.initial_stt_hard_weight), 
         stt_phased_weight(in.initial_stt_phased_weight),
         display_OF_isset(display_OF), move_counter(1), last_best_solution(0), 
-        last_best_counter(0)
+        last_best_counter(0), state_version(0), overlay(*this), involved_constraints(in), print_solution_on_one_line(false)
     {
-        cost_single_constraints[CA1].resize(in.constraints_CA1.size(),0);
-        cost_single_constraints[CA2].resize(in.constraints_CA2.size(),0);
-        cost_single_constraints[CA3].resize(in.constraints_CA3.size(),0);
-        cost_single_constraints[CA4].resize(in.constraints_CA4.size(),0);
-        cost_single_constraints[GA1].resize(in.constraints_GA1.size(),0);
-        cost_single_constraints[BR1].resize(in.constraints_BR1.size(),0);
-        cost_single_constraints[BR2].resize(in.constraints_BR2.size(),0);
-        cost_single_constraints[FA2].resize(in.constraints_FA2.size(),0);
-        cost_single_constraints[SE1].resize(in.constraints_SE1.size(),0);
+        BindStorage(); //all the arrays start zeroed
+        hard_weight_factors.fill(1);
     }
-    STT_Solution(const STT_Solution& st) : in(st.in)
+    STT_Solution(const STT_Solution& st) : in(st.in), state_version(0), overlay(*this), involved_constraints(st.in)
     {
-        opponent = st.opponent;
-        home = st.home;
-        match = st.match;
-        is_return_match = st.is_return_match;
-        cost_components = st.cost_components;
-        cost_components_hard = st.cost_components_hard;
-        cost_single_constraints = st.cost_single_constraints;
-        total_cost_components = st.total_cost_components;
-        total_cost_components_hard = st.total_cost_components_hard;
-        cost_phased = st.cost_phased;
-        stt_hard_weight = st.stt_hard_weight;
-        stt_phased_weight = st.stt_phased_weight;
-        move_counter = st.move_counter;
-        display_OF_isset = st.display_OF_isset;
-        last_best_solution = st.last_best_solution;
-        last_best_counter = st.last_best_counter;
-        print_solution_on_one_line = st.print_solution_on_one_line;
+        BindStorage();
+        *this = st;
     }
     STT_Solution& operator=(const STT_Solution& st)
     {
-        opponent = st.opponent;
-        home = st.home;
-        match = st.match;
-        is_return_match = st.is_return_match;
-        cost_components = st.cost_components;
-        cost_components_hard = st.cost_components_hard;
-        cost_single_constraints = st.cost_single_constraints;   
+        // the two blocks have the same layout only if the inputs share the same constraints (e.g., not the hard only
+        // input and the full one)
+        if (&st.in.Instance() != &in.Instance() || st.storage.size() != storage.size())
+            throw logic_error("Assignment between solutions of inputs with different constraints");
+        if (this != &st)
+            memcpy(storage.data(), st.storage.data(), storage.size()*sizeof(uint64_t));
         total_cost_components = st.total_cost_components;
         total_cost_components_hard = st.total_cost_components_hard;
         cost_phased = st.cost_phased;
+        same_phase_pairs = st.same_phase_pairs;
+        violated_count = st.violated_count;
+        fa2_touched_count = st.fa2_touched_count;
         stt_hard_weight = st.stt_hard_weight;
         stt_phased_weight = st.stt_phased_weight;
+        hard_weight_factors = st.hard_weight_factors;
         move_counter = st.move_counter;
         display_OF_isset = st.display_OF_isset;
         last_best_solution = st.last_best_solution;
         last_best_counter = st.last_best_counter;
         print_solution_on_one_line = st.print_solution_on_one_line;
+        state_version++;
         return *this;
     }
-    void CanonicalPattern(bool permute, bool mix_initial_phase = true);
+    void CanonicalPattern(STT_Random& rng, bool permute, bool mix_initial_phase = true);
     //needed by makemove functions
     void UpdateStateCell(unsigned t1, unsigned r, unsigned t2, bool home_game);
     void UpdateMatches(unsigned t1, unsigned t2, unsigned r, bool rev1 = false, bool rev2 = false);
     void InternalMakeSwapHomes(unsigned t1, unsigned t2);
-    void Shuffle(vector<size_t>::iterator start, vector<size_t>::iterator stop);
+    void Shuffle(STT_Random& rng, vector<size_t>::iterator start, vector<size_t>::iterator stop);
+    //read accessors (shared with STT_SolutionOverlay)
+    unsigned Opponent(unsigned t, unsigned s) const { return opponent[t][s]; }
+    bool Home(unsigned t, unsigned s) const { return home[t][s]; }
+    uint64_t HomeBits(unsigned t) const { return home_bits[t]; }
+    unsigned Match(unsigned t1, unsigned t2) const { return match[t1][t2]; }
 
     //other methods
     int ReturnTotalCost();
     int CalculateFullCost();
+    int LoadTimetable(const STT_Solution& st); //takes the timetable of st, whose input can be another stage of the same instance (no text round trip), and returns the new total cost
+    void PackHomeBits(); //recomputes home_bits from home (needed after home is written directly, it is done by CalculateFullCost)
     int CalculateCostComponent(unsigned int c_type);
     int CalculateCostComponentHard(unsigned int c_type);
+    int ApplyWeights(); //recomputes the weighted costs from the violations after a change of stt_hard_weight, stt_phased_weight, hard_weight_factors or in.hard_weights (O(N_CONSTRAINTS)), returns the total cost
+    bool SampleViolatedCell(STT_Random& rng, unsigned& t, unsigned& s) const; //draws a team and a slot involved in a random violated constraint (false if there is none)
+    int HardWeight(unsigned int c_type) const { return HardWeight(c_type, stt_hard_weight, hard_weight_factors); }
+    int HardWeight(unsigned int c_type, int hard_weight, const array<int, N_CONSTRAINTS>& factors) const { return hard_weight*in.hard_weights[c_type]*factors[c_type]; } //as above, with the given global weight and factors
+    int Weight(unsigned int c_type, unsigned int c) const { return in.IsHard(c_type, c) ? HardWeight(c_type) : 1; } //weight of the violation of constraint c
+    int WeighComponents(int hard_weight, const array<int, N_CONSTRAINTS>& factors) const; //total_cost_components with the given global weight and factors in place of the ones of the solution (O(N_CONSTRAINTS))
     int CalculateCostSingleConstraint(unsigned int c_type, unsigned int c) const; //calculate the value but doesn't modify the data
+    template <class State>
+    int CalculateCostSingleConstraint(const State& st, unsigned int c_type, unsigned int c) const; //as above, but the value is calculated on st (*this or an overlay on it)
+    int CalculateViolationSingleConstraint(unsigned int c_type, unsigned int c) const; //as CalculateCostSingleConstraint, but not weighted
+    template <class State>
+    int CalculateViolationSingleConstraint(const State& st, unsigned int c_type, unsigned int c) const;
+    int CalculateDeltaCostComponent(const STT_SolutionOverlay& ov, unsigned int c_type) const; //variation of cost_components[c_type] if the move simulated in ov is executed
+    int CalculateDeltaCostPhased(const STT_SolutionOverlay& ov) const; //variation of cost_phased if the move simulated in ov is executed
+    int CalculateDeltaCostFA2(const STT_SolutionOverlay& ov) const; //as CalculateDeltaCostComponent, but based on the incremental data of FA2
+    bool HardFeasible(const STT_SolutionOverlay& ov) const; //true iff no hard constraint is violated after the move simulated in ov
+    bool CalculateDeltaCostBounded(const STT_SolutionOverlay& ov, double threshold, int& delta, unsigned& evaluated) const; //as the sum of all the delta costs (hard constraints first), but it stops and returns false as soon as the delta is surely positive and not below threshold; evaluated is the number of constraints whose delta has been computed
+    void UpdateFA2Costs(); //updates the FA2 violations taking into account only the teams in fa2_touched_teams (the weighted costs are left to the caller)
+    int CA3Violation(unsigned int c) const { return in.constraints_CA3[c].penalty * ca3_excess[c]; } //violation of the CA3 constraint c, according to the incremental data
+    int FA2Violation(unsigned int c) const { return in.constraints_FA2[c].penalty * fa2_excess[c]; } //violation of the FA2 constraint c, according to the incremental data
   // calculate the single cost of a given constraint up to round r
     float GreedyCalculateCostSingleConstraint(Constraints::ConstraintType c_type, unsigned int c, unsigned int r) const;
     float GreedyCalculateCost(unsigned int r) const;
     int CalculateCostPhased();
-    void UpdateSelectionedCostsConstraints(vector<vector<unsigned>> involved_constraints); //function that, given a matrix of constraints indexes (of size N_CONSTRAINTS) as input, recalucalte the cost taking into account only those specific constraints. 
-    void RescaleWeightConstraintsBothPhases(unsigned weight);
+    int UpdateCostPhased(); //as CalculateCostPhased, but based on same_phase_pairs (already maintained by UpdateStateCell)
+    void UpdateSelectionedCostsConstraints(const vector<vector<unsigned>>& involved_constraints); //function that, given a matrix of constraints indexes (of size N_CONSTRAINTS) as input, recalucalte the cost taking into account only those specific constraints. 
 
 
     vector<vector<vector<int>>> GetCplexWarmSolution();
 
-    void UpdateLocalCostsDeleteMatch(unsigned t1, unsigned t2, unsigned old_r);
-    void UpdateLocalCostsInsertMatch(unsigned t1, unsigned t2, unsigned r);
-    vector<unsigned> getInvolvedConstraints(Constraints::ConstraintType c_type, unsigned t1, unsigned t2, unsigned s) const;
-    vector<unsigned> getInvolvedConstraints(Constraints::ConstraintType c_type, vector<unsigned> involved_teams, vector<unsigned> involved_slots) const;
-    void RecalculateConstraintsForTeamsMatches(vector<unsigned> involved_teams, vector<unsigned> involved_matches);
     bool SamePhase(unsigned int r1, unsigned int r2) const;
     void PopulateIsReturnMatrix(); //given a consistent state of opponent, home and match, populates the "is_return_match" matrix
     bool IsReturnMatch(unsigned t1, unsigned t2) const {return is_return_match[t1][match[t1][t2]];} //finds the match t1-t2 and states wheter it is a "go" or a "return"
@@ -118,31 +255,93 @@ public:
     void SetPrintSolutionOneLine(bool v) {print_solution_on_one_line = v;}
     const STT_Input& in;
     
+    // all the arrays below are views on storage
     // these were the same state structures as for the TTP
-    vector<vector<unsigned int>> opponent; // matrix (i, s) stating which is the opponent of team i at slot s
-    vector<vector<bool>> home; // matrix (i, s) stating whether the team i plays at home at slot s
+    STT_Matrix<unsigned int> opponent; // matrix (i, s) stating which is the opponent of team i at slot s
+    STT_Matrix<bool> home; // matrix (i, s) stating whether the team i plays at home at slot s
+    uint64_t* home_bits; // home/away pattern of team i packed in a word (bit s equal to home[i][s]), used by the cost kernels
     //new redundant data added on 2020-11-24 to ease the execution of SwapHomes move
-    vector<vector<unsigned int>> match; //matrix (i,j) stating which is the slot in which teams at row plays at home against teams at column
-    vector<vector<bool>> is_return_match; // matrix (i,s) stating whether the team i is playing a "go" (value false) game or a "return" (value true)
+    STT_Matrix<unsigned int> match; //matrix (i,j) stating which is the slot in which teams at row plays at home against teams at column
+    STT_Matrix<bool> is_return_match; // matrix (i,s) stating whether the team i is playing a "go" (value false) game or a "return" (value true)
 
-    //materialized costs
-    vector<int> cost_components; //usage: cost_components[Constraints::Constraint_Type c_type], example cost_components[CA1]
-    vector<int> cost_components_hard; // like cost_components, but tracks only hard cost
-    vector<vector<int>> cost_single_constraints; //usage: cost_single_constraints[Constraints::Constraint_Type c_type][unsigned i], example cost_single_constraints[CA1][4]
+    //materialized violations, independent of the weights: penalty times the amount of violation
+    STT_RaggedMatrix<int> violations; //usage: violations[Constraints::Constraint_Type c_type][unsigned i], example violations[CA1][4]
+    int* violations_hard; //usage: violations_hard[c_type], sum of the violations of the hard constraints of type c_type
+    int* violations_soft; //as violations_hard, for the soft constraints
+    //set of the violated constraints (the ones with positive violation), the i-th is constraint violated_constraints[i] of type violated_types[i]
+    unsigned* violated_types;
+    unsigned* violated_constraints;
+    unsigned violated_count;
+    STT_RaggedMatrix<unsigned> violated_position; //usage: violated_position[c_type][c], 1 + position of the constraint in the set (0 if not violated)
+    //materialized costs, derived from the violations and the weights (see WeighComponents)
+    int* cost_components; //usage: cost_components[Constraints::Constraint_Type c_type], example cost_components[CA1]
+    int* cost_components_hard; // like cost_components, but tracks only hard cost
     int total_cost_components;
     int total_cost_components_hard;
     int cost_phased;
+    int same_phase_pairs; //number of pairs of teams whose two matches are in the same phase (rebuilt by CalculateCostPhased, updated by UpdateStateCell)
+    //incremental data for CA3 (rebuilt by CalculateCostComponent(CA3), updated by UpdateSelectionedCostsConstraints)
+    STT_RaggedMatrix<uint64_t> ca3_games; //usage: ca3_games[c][i], slots in which the i-th team of the first group of CA3 constraint c plays a counted game
+    int* ca3_excess; //usage: ca3_excess[c], excess over [k_min, k_max] summed over the teams and their k-slot windows
+    //incremental data for FA2 (rebuilt by CalculateCostComponent(FA2), updated by UpdateFA2Costs)
+    STT_RaggedMatrix<int> fa2_home_games; //usage: fa2_home_games[c][i*m + k], home games of the i-th team of the group of FA2 constraint c in the first k+1 slots of its slot group (of size m)
+    STT_RaggedMatrix<int> fa2_pair_excess; //usage: fa2_pair_excess[c][i*g + j], excess over k of the max home games difference between the i-th and j-th team of the group (of size g)
+    int* fa2_excess; //usage: fa2_excess[c], sum of fa2_pair_excess[c] over the pairs i < j
+    unsigned* fa2_touched_teams; //teams whose home pattern has changed since the last update of the FA2 costs (filled by UpdateStateCell)
+    unsigned fa2_touched_count; //number of teams in fa2_touched_teams
+    bool* fa2_team_touched;
     int stt_hard_weight;
     int stt_phased_weight;
+    array<int, N_CONSTRAINTS> hard_weight_factors; //per type factors of the hard weights of this solution (all 1, except during a strategic oscillation)
     bool display_OF_isset;
     long long unsigned int move_counter;
     int last_best_solution;
     long long unsigned int last_best_counter;
+    unsigned long int state_version; //changed whenever the timetable changes (by MakeMove, assignment or full recalculation), not copied
+    mutable STT_SolutionOverlay overlay; //used to simulate moves for delta costs evaluation (not copied)
+    STT_InvolvedConstraints involved_constraints; //scratch used by the MakeMove functions (not copied)
   private:
+    vector<uint64_t> storage; //single block holding all the arrays of the solution, its layout depends only on the input (so a copy is a memcpy)
+    void BindStorage(); //allocates storage and binds the views on it
+    void SetViolation(unsigned int c_type, unsigned int c, int violation); //updates violations[c_type][c], the sums of its type and the violated set
+    void WeighComponent(unsigned int c_type); //recomputes cost_components[c_type] and cost_components_hard[c_type] from the violations
+    void WeighComponents(); //as above for all the types, together with the totals
+    void ResetCA3Data(); //rebuilds the incremental data of CA3 from scratch
+    int UpdateCA3Constraint(unsigned int c); //updates the incremental data of CA3 constraint c and returns its new violation
+    int CalculateDeltaViolationSingleCA3(const STT_SolutionOverlay& ov, unsigned int c) const; //variation of the violation of CA3 constraint c
+    void ResetFA2Data(); //rebuilds the incremental data of FA2 from scratch
+    void UpdateFA2Team(unsigned int c, unsigned int i, const int* home_games); //replaces the prefix home games of the i-th team of FA2 constraint c, updating its pairs
+    const vector<unsigned>& InvolvedConstraints(const STT_SolutionOverlay& ov, unsigned int c_type) const; //constraints of type c_type touched by the move simulated in ov (stored in ov.involved_constraints)
+    void CollectFA2InvolvedTeams(const STT_SolutionOverlay& ov) const; //stores in ov.involved_teams the teams whose home pattern is changed by the move
+    int CalculateDeltaViolationSingleFA2(const STT_SolutionOverlay& ov, unsigned int c) const; //variation of the violation of FA2 constraint c (requires CollectFA2InvolvedTeams)
     //parameters that guide the way of displaying the solution
     bool print_solution_on_one_line;
 };
 
+inline STT_SolutionOverlay::STT_SolutionOverlay(const STT_Solution& st)
+    : involved_constraints(st.in), simulated_version(0), in(st.in), st(st), epoch(0)
+{}
+
+inline unsigned STT_SolutionOverlay::Opponent(unsigned t, unsigned s) const
+{
+    return cell_epoch[t*slots + s] == epoch ? cell_opponent[t*slots + s] : st.opponent[t][s];
+}
+
+inline bool STT_SolutionOverlay::Home(unsigned t, unsigned s) const
+{
+    return cell_epoch[t*slots + s] == epoch ? cell_home[t*slots + s] : st.home[t][s];
+}
+
+inline uint64_t STT_SolutionOverlay::HomeBits(unsigned t) const
+{
+    return team_epoch[t] == epoch ? team_home_bits[t] : st.home_bits[t];
+}
+
+inline unsigned STT_SolutionOverlay::Match(unsigned t1, unsigned t2) const
+{
+    return match_epoch[t1*teams + t2] == epoch ? match_slot[t1*teams + t2] : st.match[t1][t2];
+}
+
 
 
 // ***************************************************************************
@@ -210,6 +409,36 @@ public:
     unsigned r1, r2;
 };
 
+// Repair chain of a move (rounds or teams), stored inline so that building and copying a move do not allocate.
+// A chain has no repetitions, so it is never longer than the number of slots, which is at most 64 (see SlotBit).
+class STT_Chain
+{
+public:
+    static const unsigned CAPACITY = 64;
+    STT_Chain(size_t n = 0, unsigned value = 0) : length(0) { resize(n, value); }
+    size_t size() const { return length; }
+    void clear() { length = 0; }
+    void resize(size_t n, unsigned value = 0)
+    {
+        if (n > CAPACITY)
+            throw logic_error("Repair chains longer than " + to_string(CAPACITY) + " are not supported");
+        for (size_t i = length; i < n; i++)
+            items[i] = value;
+        length = n;
+    }
+    void push_back(unsigned value)
+    {
+        if (length == CAPACITY)
+            throw logic_error("Repair chains longer than " + to_string(CAPACITY) + " are not supported");
+        items[length++] = value;
+    }
+    unsigned& operator[](size_t i) { return items[i]; }
+    unsigned operator[](size_t i) const { return items[i]; }
+private:
+    unsigned length;
+    array<unsigned, CAPACITY> items;
+};
+
 // ***************************************************************************
 // ****      NEIGHBORHOOD 4: swap matches     (NOT PHASED case)           ****
 // ***************************************************************************
@@ -224,7 +453,7 @@ class STT_SwapMatchesNotPhased
 public:
     STT_SwapMatchesNotPhased(unsigned s1 = 0, unsigned s2 = 0) : t1(s1), t2(s2), rs(1,0) {}
     unsigned t1, t2;
-    mutable vector<unsigned> rs; // this part is computed while checking the move 
+    mutable STT_Chain rs; // this part is computed while checking the move 
 };
 
 // ***************************************************************************
@@ -239,11 +468,11 @@ class STT_SwapMatchesPhased
     friend ostream& operator<<(ostream& os, const STT_SwapMatchesPhased& m);
     friend istream& operator>>(istream& is, STT_SwapMatchesPhased& m);
 public:
-    STT_SwapMatchesPhased(unsigned s1 = 0, unsigned s2 = 0) : t1(s1), t2(s2), rs(1,0), swap_homes_t1(1,false), swap_homes_t2(1,false) {}
+    STT_SwapMatchesPhased(unsigned s1 = 0, unsigned s2 = 0) : t1(s1), t2(s2), rs(1,0), swap_homes_t1(0), swap_homes_t2(0) {}
     unsigned t1, t2;
-    mutable vector<unsigned> rs; // this part is computed while checking the move 
-    mutable vector<bool> swap_homes_t1; // this part is computed while checking the move (we have to calculate it in advance)
-    mutable vector<bool> swap_homes_t2; // this part is computed while checking the move (we have to calculate it in advance)
+    mutable STT_Chain rs; // this part is computed while checking the move 
+    mutable uint64_t swap_homes_t1; // bit r refers to rs[r]; this part is computed while checking the move (we have to calculate it in advance)
+    mutable uint64_t swap_homes_t2; // bit r refers to rs[r]; this part is computed while checking the move (we have to calculate it in advance)
 };
 
 
@@ -261,7 +490,7 @@ class STT_SwapMatchRound
 public:
     STT_SwapMatchRound(unsigned s1 = 0, unsigned s2 = 0) : r1(s1), r2(s2), ts(1,0) {}
     unsigned r1, r2;
-    mutable vector<unsigned> ts; // this part is computed while checking the move
+    mutable STT_Chain ts; // this part is computed while checking the move
 
 };
 
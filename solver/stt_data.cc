@@ -26,10 +26,31 @@ ostream &operator<<(ostream &os, const Slot &s)
 }
 
 STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight, bool only_hard, bool mix_phase_during_search, bool forbid_hard_worsening_moves, bool stop_at_zero_hard, array<int, N_CONSTRAINTS> detailed_hard_weights)
-    : initial_stt_hard_weight(global_hard_weight), initial_stt_phased_weight(phased_weight),
+    : STT_Input(make_shared<const STT_Instance>(filename), global_hard_weight, phased_weight, only_hard, mix_phase_during_search,
+                forbid_hard_worsening_moves, stop_at_zero_hard, detailed_hard_weights)
+{}
+
+STT_Input::STT_Input(shared_ptr<const STT_Instance> instance, int global_hard_weight, int phased_weight, bool only_hard, bool mix_phase_during_search, bool forbid_hard_worsening_moves, bool stop_at_zero_hard, array<int, N_CONSTRAINTS> detailed_hard_weights)
+    : instance(only_hard ? instance->HardOnly() : instance),
+      name(this->instance->name), league_name(this->instance->league_name), phased(this->instance->phased),
+      teams(this->instance->teams), slots(this->instance->slots),
+      team_group(this->instance->team_group), slot_group(this->instance->slot_group),
+      groups_of_team(this->instance->groups_of_team), groups_of_slot(this->instance->groups_of_slot),
+      slot_group_mask(this->instance->slot_group_mask),
+      constraints_CA1(this->instance->constraints_CA1), constraints_CA2(this->instance->constraints_CA2),
+      constraints_CA3(this->instance->constraints_CA3), constraints_CA4(this->instance->constraints_CA4),
+      constraints_GA1(this->instance->constraints_GA1), constraints_BR1(this->instance->constraints_BR1),
+      constraints_BR2(this->instance->constraints_BR2), constraints_FA2(this->instance->constraints_FA2),
+      constraints_SE1(this->instance->constraints_SE1),
+      constraints_hard_indexes(this->instance->constraints_hard_indexes),
+      FA2_team_position(this->instance->FA2_team_position), CA3_team_position(this->instance->CA3_team_position),
+      initial_stt_hard_weight(global_hard_weight), initial_stt_phased_weight(phased_weight),
       only_hard(only_hard), mix_phase_during_search(mix_phase_during_search),
       forbid_hard_worsening_moves(forbid_hard_worsening_moves),
-      stop_at_zero_hard(stop_at_zero_hard), hard_weights(detailed_hard_weights)
+      stop_at_zero_hard(stop_at_zero_hard), hard_weights(detailed_hard_weights), violation_guided_rate(0.0)
+{}
+
+STT_Instance::STT_Instance(string filename)
 {
   constraints_hard_indexes.resize(N_CONSTRAINTS, vector<unsigned>(0));
 
@@ -91,6 +112,8 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
     slot_index[id] = slots.size();
     slots.push_back(Slot{id, s.node().attribute("name").as_string()});
   }
+  if (slots.size() > 64)
+    throw logic_error("The home/away patterns are stored in 64-bit words, at most 64 slots are supported, found " + to_string(slots.size()));
   // TODO: dispatch SlotGroups
   // Explicit slot groups are supposed not to be present, but just implicit ones as mentioned in
   // constraints, check against it
@@ -149,13 +172,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
           break;
         }
       }
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_CA1, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_CA1, constraint);
+      ADD_CONSTRAINT(constraints_CA1, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -201,13 +218,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
         }
       }
       // constraints_CA2.push_back(constraint);
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_CA2, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_CA2, constraint);
+      ADD_CONSTRAINT(constraints_CA2, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -244,13 +255,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
       // constraints_CA3.push_back(constraint);
       //popolo il valore di constraint.both_phases
       constraint.both_phases = false;
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_CA3, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_CA3, constraint);
+      ADD_CONSTRAINT(constraints_CA3, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -298,13 +303,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
         }
       }
       // constraints_CA4.push_back(constraint);
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_CA4, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_CA4, constraint);
+      ADD_CONSTRAINT(constraints_CA4, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -345,13 +344,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
         }
       }
       // constraints_GA1.push_back(constraint);
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_GA1, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_GA1, constraint);
+      ADD_CONSTRAINT(constraints_GA1, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -397,13 +390,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
         }
       }
       // constraints_BR1.push_back(constraint);
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_BR1, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_BR1, constraint);
+      ADD_CONSTRAINT(constraints_BR1, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -440,13 +427,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
           break;
         }
       }
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_BR2, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_BR2, constraint);
+      ADD_CONSTRAINT(constraints_BR2, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -491,13 +472,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
         }
       }
       // constraints_FA2.push_back(constraint);
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_FA2, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_FA2, constraint);
+      ADD_CONSTRAINT(constraints_FA2, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -529,13 +504,7 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
       constraint.team_group_index = DispatchTeamIds(c.attribute("teams").as_string());
       constraint.both_phases = false;
       // constraints_SE1.push_back(constraint);
-      if (only_hard)
-      {
-        if (constraint.hard)
-          ADD_CONSTRAINT(constraints_SE1, constraint);
-      }
-      else
-        ADD_CONSTRAINT(constraints_SE1, constraint);
+      ADD_CONSTRAINT(constraints_SE1, constraint);
 
       //in ogni caso
       if (constraint.hard)
@@ -545,31 +514,81 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
       throw logic_error("Game constraints of type " + string(c.name()) + " are not allowed");
   }
 
+  BuildIndexes();
+}
+
+STT_Instance::STT_Instance(const STT_Instance &instance, bool only_hard)
+    : STT_Instance(instance)
+{
+  if (only_hard)
+  {
+    // keep only the hard constraints, the groups are left untouched
+    auto filter_hard = [](auto &constraints)
+    {
+      constraints.erase(remove_if(begin(constraints), end(constraints), [](const auto &c)
+                                  { return !c.hard; }),
+                        end(constraints));
+    };
+    filter_hard(constraints_CA1);
+    filter_hard(constraints_CA2);
+    filter_hard(constraints_CA3);
+    filter_hard(constraints_CA4);
+    filter_hard(constraints_GA1);
+    filter_hard(constraints_BR1);
+    filter_hard(constraints_BR2);
+    filter_hard(constraints_FA2);
+    filter_hard(constraints_SE1);
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+    {
+      constraints_hard_indexes[c_type].resize(ConstraintsVectorSize(c_type));
+      for (unsigned int i = 0; i < constraints_hard_indexes[c_type].size(); i++)
+        constraints_hard_indexes[c_type][i] = i;
+    }
+  }
+  BuildIndexes();
+}
+
+shared_ptr<const STT_Instance> STT_Instance::HardOnly() const
+{
+  call_once(hard_only.built, [this]() { hard_only.instance = shared_ptr<const STT_Instance>(new STT_Instance(*this, true)); });
+  return hard_only.instance;
+}
+
+void STT_Instance::BuildIndexes()
+{
   // *******************************************
   // Auxiliary data for efficient access
   // *******************************************
 
   // these are the reverse index of groups to teams / slots
 
-  groups_of_team.resize(teams.size());
+  groups_of_team.assign(teams.size(), list<unsigned int>());
   for (size_t i = 0; i < team_group.size(); i++)
   {
     for (auto t : team_group[i])
       groups_of_team[t].push_back(i);
   }
 
-  groups_of_slot.resize(slots.size());
+  groups_of_slot.assign(slots.size(), list<unsigned int>());
   for (size_t i = 0; i < slot_group.size(); i++)
   {
     for (auto s : slot_group[i])
       groups_of_slot[s].push_back(i);
   }
 
+  // bit masks of the slot groups, to be used on the home/away patterns
+  slot_group_mask.assign(slot_group.size(), 0);
+  for (size_t i = 0; i < slot_group.size(); i++)
+  {
+    for (auto s : slot_group[i])
+      slot_group_mask[i] |= SlotBit(s);
+  }
+
   // Auxiliary Data: Now I populate the inverse matrices from team/slots to constraints
-  // I resize the matrices
-  team_slot_constraints.resize(N_CONSTRAINTS, vector<vector<vector<unsigned>>>(teams.size(), vector<vector<unsigned>>(slots.size(), vector<unsigned>(0, 0))));
-  team_constraints.resize(N_CONSTRAINTS, vector<vector<unsigned>>(teams.size(), vector<unsigned>(0, 0)));
-  slot_constraints.resize(N_CONSTRAINTS, vector<vector<unsigned>>(slots.size(), vector<unsigned>(0, 0)));
+  // they are built as nested vectors and finally compacted in the CSR indexes
+  vector<vector<vector<vector<unsigned>>>> team_slot_constraints(N_CONSTRAINTS, vector<vector<vector<unsigned>>>(teams.size(), vector<vector<unsigned>>(slots.size(), vector<unsigned>(0, 0))));
+  vector<vector<vector<unsigned>>> team_constraints(N_CONSTRAINTS, vector<vector<unsigned>>(teams.size(), vector<unsigned>(0, 0)));
+  vector<vector<vector<unsigned>>> slot_constraints(N_CONSTRAINTS, vector<vector<unsigned>>(slots.size(), vector<unsigned>(0, 0)));
   // I execute, for each constraint, a cycle to fill in the matrix
 
   unsigned t1, t2, s1; //dichiaro quattro variabili di supporto per rendere più leggibile il codice seguente
@@ -860,6 +879,18 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
           team_slot_constraints[FA2][t1][s1].push_back(i);
       }
 
+  //position of each team inside the team group of each FA2 constraint (used by the incremental FA2 evaluation)
+  FA2_team_position.assign(constraints_FA2.size(), vector<int>(teams.size(), -1));
+  for (unsigned int i = 0; i < constraints_FA2.size(); i++)
+    for (unsigned int t = 0; t < team_group[constraints_FA2[i].team_group_index].size(); t++)
+      FA2_team_position[i][team_group[constraints_FA2[i].team_group_index][t]] = t;
+
+  //position of each team inside the first team group of each CA3 constraint (used by the incremental CA3 evaluation)
+  CA3_team_position.assign(constraints_CA3.size(), vector<int>(teams.size(), -1));
+  for (unsigned int i = 0; i < constraints_CA3.size(); i++)
+    for (unsigned int t = 0; t < team_group[constraints_CA3[i].team_group_1_index].size(); t++)
+      CA3_team_position[i][team_group[constraints_CA3[i].team_group_1_index][t]] = t;
+
   //SE1
   //per ogni constraint
   //per tutti gli slot (questo vincolo non è riferito a uno slot specifico)
@@ -917,9 +948,50 @@ STT_Input::STT_Input(string filename, int global_hard_weight, int phased_weight,
           if (!already_in_vector)
             slot_constraints[c_type][s].push_back(team_slot_constraints[c_type][t][s][i]);
         }
+
+  //teams and slots involved in each constraint (i.e., the inverse of team_slot_constraints)
+  vector<vector<vector<unsigned>>> constraint_teams(N_CONSTRAINTS), constraint_slots(N_CONSTRAINTS);
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+  {
+    constraint_teams[c_type].resize(ConstraintsVectorSize(c_type));
+    constraint_slots[c_type].resize(ConstraintsVectorSize(c_type));
+    for (unsigned int t = 0; t < teams.size(); t++)
+      for (unsigned int s = 0; s < slots.size(); s++)
+        for (auto c : team_slot_constraints[c_type][t][s])
+          if (constraint_teams[c_type][c].empty() || constraint_teams[c_type][c].back() != t)
+            constraint_teams[c_type][c].push_back(t);
+    for (unsigned int s = 0; s < slots.size(); s++)
+      for (unsigned int t = 0; t < teams.size(); t++)
+        for (auto c : team_slot_constraints[c_type][t][s])
+          if (constraint_slots[c_type][c].empty() || constraint_slots[c_type][c].back() != s)
+            constraint_slots[c_type][c].push_back(s);
+  }
+
+  //compact the inverse matrices in CSR format
+  team_slot_constraints_index.assign(N_CONSTRAINTS, ConstraintIndex());
+  team_constraints_index.assign(N_CONSTRAINTS, ConstraintIndex());
+  slot_constraints_index.assign(N_CONSTRAINTS, ConstraintIndex());
+  constraint_teams_index.assign(N_CONSTRAINTS, ConstraintIndex());
+  constraint_slots_index.assign(N_CONSTRAINTS, ConstraintIndex());
+  for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+  {
+    for (unsigned int c = 0; c < ConstraintsVectorSize(c_type); c++)
+    {
+      constraint_teams_index[c_type].AddRow(constraint_teams[c_type][c]);
+      constraint_slots_index[c_type].AddRow(constraint_slots[c_type][c]);
+    }
+    for (unsigned int t = 0; t < teams.size(); t++)
+    {
+      for (unsigned int s = 0; s < slots.size(); s++)
+        team_slot_constraints_index[c_type].AddRow(team_slot_constraints[c_type][t][s]);
+      team_constraints_index[c_type].AddRow(team_constraints[c_type][t]);
+    }
+    for (unsigned int s = 0; s < slots.size(); s++)
+      slot_constraints_index[c_type].AddRow(slot_constraints[c_type][s]);
+  }
 }
 
-unsigned int STT_Input::DispatchTeamIds(const string &team_ids)
+unsigned int STT_Instance::DispatchTeamIds(const string &team_ids)
 {
   // transform the groups id into their indexes
   auto _team_group = split(team_ids, ";");
@@ -939,7 +1011,7 @@ unsigned int STT_Input::DispatchTeamIds(const string &team_ids)
   return team_group_index;
 }
 
-unsigned int STT_Input::DispatchSlotIds(const string &slot_ids)
+unsigned int STT_Instance::DispatchSlotIds(const string &slot_ids)
 {
   auto _slot_group = split(slot_ids, ";");
   std::vector<unsigned int> cur_slot_group;
@@ -959,7 +1031,7 @@ unsigned int STT_Input::DispatchSlotIds(const string &slot_ids)
   return slot_group_index;
 }
 
-vector<pair<unsigned int, unsigned int>> STT_Input::DispatchMeetings(const string &meetings)
+vector<pair<unsigned int, unsigned int>> STT_Instance::DispatchMeetings(const string &meetings)
 {
   auto _meetings_group = split(meetings, ";");
   std::vector<pair<unsigned int, unsigned int>> meeting_indexes;
@@ -977,7 +1049,7 @@ vector<pair<unsigned int, unsigned int>> STT_Input::DispatchMeetings(const strin
   return meeting_indexes;
 }
 
-bool STT_Input::IsHard(unsigned int c_type, unsigned int c) const
+bool STT_Instance::IsHard(unsigned int c_type, unsigned int c) const
 {
   switch (c_type)
   {
@@ -1003,7 +1075,7 @@ bool STT_Input::IsHard(unsigned int c_type, unsigned int c) const
   return false;
 }
 
-unsigned int STT_Input::ConstraintsVectorSize(unsigned int c_type) const
+unsigned int STT_Instance::ConstraintsVectorSize(unsigned int c_type) const
 {
   switch (c_type)
   {
@@ -1030,6 +1102,11 @@ unsigned int STT_Input::ConstraintsVectorSize(unsigned int c_type) const
 }
 
 ostream &operator<<(ostream &os, const STT_Input &in)
+{
+  return os << in.Instance();
+}
+
+ostream &operator<<(ostream &os, const STT_Instance &in)
 {
   os << "Name: " << in.name << " (" << in.league_name << ")" << endl;
   os << "Game Mode: " << (in.phased ? "phased" : "non-phased") << endl;
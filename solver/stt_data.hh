@@ -12,6 +12,10 @@
 #include <map>
 #include <pugixml.hpp>
 #include <sstream>
+#include <cstdint>
+#include <bitset>
+#include <memory>
+#include <mutex>
 #include "stt_constraints.hh"
 
 using namespace std;
@@ -34,14 +38,56 @@ struct Slot
     string name;
 };
 
-class STT_Input
+// the home/away pattern of a team is stored in a 64-bit word: bit s is set iff the team plays at home at slot s
+inline uint64_t SlotBit(unsigned int s) {return uint64_t(1) << s;}
+inline uint64_t SlotsUpTo(unsigned int s) {return (SlotBit(s) << 1) - 1;} // bits of the slots 0, ..., s (s < 64)
+inline int PopCount(uint64_t x) {return bitset<64>(x).count();}
+inline int LowestSlot(uint64_t x) {return PopCount((x & (~x + 1)) - 1);} // index of the lowest set bit (x != 0)
+inline int HighestSlot(uint64_t x) // index of the highest set bit (x != 0)
+{
+    for (unsigned int i = 1; i < 64; i <<= 1)
+        x |= x >> i;
+    return PopCount(x) - 1;
+}
+
+// read-only view on a contiguous range of constraint indexes
+struct ConstraintSpan
+{
+    ConstraintSpan(const unsigned int* first, const unsigned int* last) : first(first), last(last) {}
+    const unsigned int* begin() const {return first;}
+    const unsigned int* end() const {return last;}
+    size_t size() const {return last - first;}
+    bool empty() const {return first == last;}
+    unsigned int operator[](size_t i) const {return first[i];}
+    const unsigned int* first;
+    const unsigned int* last;
+};
+
+// reverse index in compressed sparse row format: the constraints of row r are
+// payload[offsets[r]], ..., payload[offsets[r + 1] - 1]
+class ConstraintIndex
 {
-    friend ostream& operator<<(ostream& os, const STT_Input& in);
 public:
-    STT_Input(string filename, int global_hard_weight, 
-    int phased_weight, bool only_hard = false, bool mix_phase_during_search = true, 
-    bool forbid_hard_worsening_moves = false, bool stop_at_zero_hard = false,
-    array<int, N_CONSTRAINTS> detailed_hard_weights = {1, 1, 1, 1, 1, 1, 1, 1, 1});
+    ConstraintIndex() : offsets(1, 0) {}
+    void AddRow(const vector<unsigned int>& row)
+    {
+        payload.insert(payload.end(), row.begin(), row.end());
+        offsets.push_back(payload.size());
+    }
+    ConstraintSpan operator[](unsigned int r) const {return ConstraintSpan(payload.data() + offsets[r], payload.data() + offsets[r + 1]);}
+private:
+    vector<unsigned int> offsets;
+    vector<unsigned int> payload;
+};
+
+// The data of an instance as parsed from the XML file, together with the redundant indexes built on it.
+// It is immutable and shared by the inputs of all the stages (see STT_Input), so the file is parsed only once.
+class STT_Instance
+{
+    friend ostream& operator<<(ostream& os, const STT_Instance& in);
+public:
+    STT_Instance(string filename);
+    shared_ptr<const STT_Instance> HardOnly() const; //the instance restricted to its hard constraints (built on the first call, then shared, thread safe)
     unsigned Teams() const {return teams.size();}
     string PrintSlots(const std::vector<unsigned int>& list) const
     {
@@ -104,6 +150,8 @@ protected:
             return -1;
     }
     
+    STT_Instance(const STT_Instance& instance, bool only_hard); //copy of instance, restricted to the hard constraints if only_hard
+    void BuildIndexes(); //builds the redundant data from the groups and the constraints
     unsigned int DispatchTeamIds(const string& team_ids);
     unsigned int DispatchSlotIds(const string& slot_ids);
     vector<pair<unsigned int, unsigned int>> DispatchMeetings(const string& meetings);
@@ -123,13 +171,6 @@ protected:
     map<string, unsigned int> slot_index;
     
 public:
-  int initial_stt_hard_weight;
-  int initial_stt_phased_weight;
-  bool only_hard;
-  bool mix_phase_during_search;
-  bool forbid_hard_worsening_moves;
-  bool stop_at_zero_hard;
-  array<int, N_CONSTRAINTS> hard_weights;
     // a team group is either an explicit group, if mentioned in the instance
     // or an implicit one if mentioned in the constraints
     // it is assumed that the indexes of the team members of each group are sorted in increasing order
@@ -146,6 +187,9 @@ public:
     
     // reverse index, indicating for each slot to which slot groups it belongs to
     vector<list<unsigned int>> groups_of_slot;
+
+    // slot_group_mask[g] has the bit s set iff the slot s belongs to the slot group g
+    vector<uint64_t> slot_group_mask;
         
     vector<CA1Spec> constraints_CA1;
     vector<CA2Spec> constraints_CA2;
@@ -163,15 +207,104 @@ public:
     
     // Redundant
     // data needed for material cost, inverse matrix[t,s] that contains 
-    // for each team (t) and slot (s) the vector of constraints in which it appears
+    // for each team (t) and slot (s) the constraints in which it appears
     // please note that there is a different matrix for each constraint,
-    // each one is indexed by by the Constraints::ConstraintType because
-    // each matrix is in a pair with its Constraints::ConstraintType
-    // Usage: team_slot_constraints[GA1][t][s][i] to access the i-th constraint
-    // that involves team s and slot s for constraint type GA1
-    vector<vector<vector<vector<unsigned int>>>> team_slot_constraints;
-    vector<vector<vector<unsigned int>>> team_constraints;
-    vector<vector<vector<unsigned int>>> slot_constraints;
+    // each one is indexed by by the Constraints::ConstraintType
+    // Usage: TeamSlotConstraints(GA1, t, s)[i] to access the i-th constraint
+    // that involves team t and slot s for constraint type GA1
+    ConstraintSpan TeamSlotConstraints(unsigned int c_type, unsigned int t, unsigned int s) const {return team_slot_constraints_index[c_type][t*slots.size() + s];}
+    ConstraintSpan TeamConstraints(unsigned int c_type, unsigned int t) const {return team_constraints_index[c_type][t];}
+    ConstraintSpan SlotConstraints(unsigned int c_type, unsigned int s) const {return slot_constraints_index[c_type][s];}
+    // inverse of the above: the teams and the slots involved in constraint c (here the spans hold team and slot indexes)
+    ConstraintSpan ConstraintTeams(unsigned int c_type, unsigned int c) const {return constraint_teams_index[c_type][c];}
+    ConstraintSpan ConstraintSlots(unsigned int c_type, unsigned int c) const {return constraint_slots_index[c_type][c];}
+    // FA2_team_position[c][t] is the position of team t in the team group of the FA2 constraint c (-1 if it does not belong to it)
+    vector<vector<int>> FA2_team_position;
+    // CA3_team_position[c][t] is the position of team t in the first team group of the CA3 constraint c (-1 if it does not belong to it)
+    vector<vector<int>> CA3_team_position;
     bool IsHard(unsigned int c_type, unsigned int c) const;
     unsigned int ConstraintsVectorSize(unsigned int c_type) const;
+protected:
+    // the three reverse indexes above, stored in CSR format (rows of team_slot_constraints are t*slots.size() + s)
+    vector<ConstraintIndex> team_slot_constraints_index;
+    vector<ConstraintIndex> team_constraints_index;
+    vector<ConstraintIndex> slot_constraints_index;
+    // rows are the constraints of each type
+    vector<ConstraintIndex> constraint_teams_index;
+    vector<ConstraintIndex> constraint_slots_index;
+    // cache of HardOnly(), built once even if several threads call it (a copy of the instance starts without it)
+    struct HardOnlyCache
+    {
+        HardOnlyCache() {}
+        HardOnlyCache(const HardOnlyCache&) {}
+        HardOnlyCache& operator=(const HardOnlyCache&) {return *this;}
+        once_flag built;
+        shared_ptr<const STT_Instance> instance;
+    };
+    mutable HardOnlyCache hard_only;
+};
+
+// The input of a stage of the solver: the (shared) instance data, seen through references with the same
+// names of the STT_Instance members, plus the configuration of the stage (weights and search flags)
+class STT_Input
+{
+    friend ostream& operator<<(ostream& os, const STT_Input& in);
+public:
+    STT_Input(string filename, int global_hard_weight, 
+    int phased_weight, bool only_hard = false, bool mix_phase_during_search = true, 
+    bool forbid_hard_worsening_moves = false, bool stop_at_zero_hard = false,
+    array<int, N_CONSTRAINTS> detailed_hard_weights = {1, 1, 1, 1, 1, 1, 1, 1, 1});
+    STT_Input(shared_ptr<const STT_Instance> instance, int global_hard_weight, 
+    int phased_weight, bool only_hard = false, bool mix_phase_during_search = true, 
+    bool forbid_hard_worsening_moves = false, bool stop_at_zero_hard = false,
+    array<int, N_CONSTRAINTS> detailed_hard_weights = {1, 1, 1, 1, 1, 1, 1, 1, 1});
+    STT_Input(const STT_Input&) = delete;
+    STT_Input& operator=(const STT_Input&) = delete;
+    unsigned Teams() const {return instance->Teams();}
+    string PrintSlots(const std::vector<unsigned int>& list) const {return instance->PrintSlots(list);}
+    string PrintTeams(const std::vector<unsigned int>& list) const {return instance->PrintTeams(list);}
+    string PrintMeetings(const std::vector<pair<unsigned int, unsigned int>>& list) const {return instance->PrintMeetings(list);}
+    ConstraintSpan TeamSlotConstraints(unsigned int c_type, unsigned int t, unsigned int s) const {return instance->TeamSlotConstraints(c_type, t, s);}
+    ConstraintSpan TeamConstraints(unsigned int c_type, unsigned int t) const {return instance->TeamConstraints(c_type, t);}
+    ConstraintSpan SlotConstraints(unsigned int c_type, unsigned int s) const {return instance->SlotConstraints(c_type, s);}
+    ConstraintSpan ConstraintTeams(unsigned int c_type, unsigned int c) const {return instance->ConstraintTeams(c_type, c);}
+    ConstraintSpan ConstraintSlots(unsigned int c_type, unsigned int c) const {return instance->ConstraintSlots(c_type, c);}
+    bool IsHard(unsigned int c_type, unsigned int c) const {return instance->IsHard(c_type, c);}
+    unsigned int ConstraintsVectorSize(unsigned int c_type) const {return instance->ConstraintsVectorSize(c_type);}
+    const STT_Instance& Instance() const {return *instance;}
+private:
+    shared_ptr<const STT_Instance> instance; //the full instance, or its hard only restriction if only_hard (declared before the references)
+public:
+    const string& name;
+    const string& league_name;
+    const bool& phased;
+    const vector<Team>& teams;
+    const vector<Slot>& slots;
+    const vector<vector<unsigned int>>& team_group;
+    const vector<vector<unsigned int>>& slot_group;
+    const vector<list<unsigned int>>& groups_of_team;
+    const vector<list<unsigned int>>& groups_of_slot;
+    const vector<uint64_t>& slot_group_mask;
+    const vector<CA1Spec>& constraints_CA1;
+    const vector<CA2Spec>& constraints_CA2;
+    const vector<CA3Spec>& constraints_CA3;
+    const vector<CA4Spec>& constraints_CA4;
+    const vector<GA1Spec>& constraints_GA1;
+    const vector<BR1Spec>& constraints_BR1;
+    const vector<BR2Spec>& constraints_BR2;
+    const vector<FA2Spec>& constraints_FA2;
+    const vector<SE1Spec>& constraints_SE1;
+    const vector<vector<unsigned>>& constraints_hard_indexes;
+    const vector<vector<int>>& FA2_team_position;
+    const vector<vector<int>>& CA3_team_position;
+
+    // configuration of the stage
+    int initial_stt_hard_weight;
+    int initial_stt_phased_weight;
+    bool only_hard;
+    bool mix_phase_during_search;
+    bool forbid_hard_worsening_moves;
+    bool stop_at_zero_hard;
+    array<int, N_CONSTRAINTS> hard_weights;
+    double violation_guided_rate; // probability that a random move starts from a team and a slot of a violated constraint
 };
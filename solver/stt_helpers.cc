@@ -16,7 +16,7 @@ using namespace boost::coroutines2;
 
 void STT_SolutionManager::RandomState(STT_Solution& st)
 {
-    st.CanonicalPattern(true, mix_initial_phase);
+    st.CanonicalPattern(rng, true, mix_initial_phase);
     st.display_OF_isset = display_OF;
     st.last_best_solution = st.CalculateFullCost();
     st.last_best_counter = st.move_counter;
@@ -24,8 +24,8 @@ void STT_SolutionManager::RandomState(STT_Solution& st)
 
 std::vector<std::pair<unsigned int, unsigned int>> canonical_order(unsigned int teams)
 {
-  static unsigned int s_teams = 0;
-  static std::vector<std::pair<unsigned int, unsigned int>> order;
+  thread_local unsigned int s_teams = 0;
+  thread_local std::vector<std::pair<unsigned int, unsigned int>> order;
   if (s_teams != teams)
   {
     order.resize(0);
@@ -37,23 +37,23 @@ std::vector<std::pair<unsigned int, unsigned int>> canonical_order(unsigned int
   return order;
 }
 
-std::vector<std::pair<unsigned int, unsigned int>> random_order(unsigned int teams)
+std::vector<std::pair<unsigned int, unsigned int>> random_order(unsigned int teams, STT_Random& rng)
 {
-  static unsigned int s_teams = 0;
-  static std::vector<std::pair<unsigned int, unsigned int>> order;
+  thread_local unsigned int s_teams = 0;
+  thread_local std::vector<std::pair<unsigned int, unsigned int>> order;
   if (s_teams != teams)
   {
     order.resize(0);
     order.push_back(make_pair(0, 1));
     std::vector<unsigned int> still_available(teams - 2);
     std::iota(begin(still_available), end(still_available), 2);
-    std::shuffle(begin(still_available), end(still_available), Random::GetGenerator());
+    std::shuffle(begin(still_available), end(still_available), rng.Generator());
     while (!still_available.empty())
     {
-      size_t i1 = Random::Uniform(static_cast<size_t>(0), still_available.size() - 1);
+      size_t i1 = rng.Uniform(static_cast<size_t>(0), still_available.size() - 1);
       unsigned int t1 = still_available[i1];
       still_available.erase(begin(still_available) + i1);
-      size_t i2 = Random::Uniform(static_cast<size_t>(0), still_available.size() - 1);
+      size_t i2 = rng.Uniform(static_cast<size_t>(0), still_available.size() - 1);
       unsigned int t2 = still_available[i2];
       still_available.erase(begin(still_available) + i2);
       if (t1 < t2)
@@ -67,9 +67,9 @@ std::vector<std::pair<unsigned int, unsigned int>> random_order(unsigned int tea
 }
 
 template <typename T>
-T random_pick_from_set(std::vector<T> s)
+T random_pick_from_set(std::vector<T> s, STT_Random& rng)
 {
-  return *(s.begin() + Random::Uniform(static_cast<size_t>(0), s.size() - 1));
+  return *(s.begin() + rng.Uniform(static_cast<size_t>(0), s.size() - 1));
 }
 
 template <typename T>
@@ -78,6 +78,13 @@ void remove_from_set(std::vector<T>& s, T value)
   s.erase(std::remove(begin(s), end(s), value));
 }
 
+// with probability in.violation_guided_rate draws a team and a slot involved in a violated constraint, so that the
+// random moves start where the cost can be reduced (returns false if they are not drawn, no random number is used if the rate is 0)
+static bool GuidedTeamAndSlot(STT_Random& rng, const STT_Solution& st, unsigned& t, unsigned& s)
+{
+  return st.in.violation_guided_rate > 0.0 && rng.Uniform<double>(0.0, 1.0) < st.in.violation_guided_rate && st.SampleViolatedCell(rng, t, s);
+}
+
 template <typename T>
 void add_to_set(std::vector<T>& s, T value)
 {
@@ -123,7 +130,7 @@ std::list<std::pair<size_t, size_t>> chain(std::vector<std::pair<size_t, size_t>
   return path;
 }
 
-void color_edges(std::vector<std::pair<size_t, size_t>> edges, size_t n, std::vector<int>& edge_color)
+void color_edges(std::vector<std::pair<size_t, size_t>> edges, size_t n, std::vector<int>& edge_color, STT_Random& rng)
 {
   std::vector<size_t> unassigned_edges, subgraph_edges;
   std::vector<int> colors;
@@ -153,14 +160,14 @@ void color_edges(std::vector<std::pair<size_t, size_t>> edges, size_t n, std::ve
   {
     if (tabu == -1)
     {
-      e0 = random_pick_from_set(unassigned_edges);
+      e0 = random_pick_from_set(unassigned_edges, rng);
       std::tie(v0, w) = edges[e0];
     }
     std::vector<int> available_common_colors;
     std::set_intersection(begin(available_colors[v0]), end(available_colors[v0]), begin(available_colors[w]), end(available_colors[w]), std::back_inserter(available_common_colors));
     if (!available_common_colors.empty())
     {
-      phi = random_pick_from_set(available_common_colors);
+      phi = random_pick_from_set(available_common_colors, rng);
       edge_color[e0] = phi;
       
       remove_from_set(available_colors[v0], phi);
@@ -171,10 +178,10 @@ void color_edges(std::vector<std::pair<size_t, size_t>> edges, size_t n, std::ve
     {
       do
       {
-        alpha0 = random_pick_from_set(available_colors[v0]);
+        alpha0 = random_pick_from_set(available_colors[v0], rng);
       }
       while (alpha0 == tabu);
-      beta = random_pick_from_set(available_colors[w]);
+      beta = random_pick_from_set(available_colors[w], rng);
       auto p = chain(edges, n, edge_color, std::make_pair(v0, w), std::make_pair(alpha0, beta));
       if (p.back().second != w) // the path does not end at w
       {
@@ -224,7 +231,7 @@ void color_edges(std::vector<std::pair<size_t, size_t>> edges, size_t n, std::ve
   }
 }
 
-std::vector<std::vector<unsigned int>> compute_vizing_matches(std::vector<unsigned int> permutation)
+std::vector<std::vector<unsigned int>> compute_vizing_matches(std::vector<unsigned int> permutation, STT_Random& rng)
 {
   size_t teams = permutation.size();
   size_t rounds = teams - 1;
@@ -247,7 +254,7 @@ std::vector<std::vector<unsigned int>> compute_vizing_matches(std::vector<unsign
   }
   for (size_t t = 4; t <= teams; t++)
   {
-    color_edges(edges, t, edge_color);
+    color_edges(edges, t, edge_color, rng);
     size_t colored = 0;
     for (size_t e1 = 0; e1 < edges.size() - 1; e1++)
     {
@@ -419,19 +426,21 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
 {
   std::vector<unsigned int> permutation(st.in.teams.size());
   std::iota(begin(permutation), end(permutation), 0);
-  std::shuffle(begin(permutation), end(permutation), Random::GetGenerator());
+  std::shuffle(begin(permutation), end(permutation), rng.Generator());
   std::vector<vector<unsigned int>> candidate_tournament_first_leg, candidate_tournament_second_leg;
   // get two candidate tournaments, one for each leg and just a single matches ordering (it is irrelevant which one to use)
   if (vizing_greedy)
-    candidate_tournament_first_leg = compute_vizing_matches(permutation);
+    candidate_tournament_first_leg = compute_vizing_matches(permutation, rng);
   else
     candidate_tournament_first_leg = compute_polygon_matches(permutation);
-  std::shuffle(begin(permutation), end(permutation), Random::GetGenerator());
+  std::shuffle(begin(permutation), end(permutation), rng.Generator());
   if (vizing_greedy)
-    candidate_tournament_second_leg = compute_vizing_matches(permutation);
+    candidate_tournament_second_leg = compute_vizing_matches(permutation, rng);
   else
     candidate_tournament_second_leg = compute_polygon_matches(permutation);
-  st.match = std::vector<std::vector<unsigned int>>(in.teams.size(), std::vector<unsigned int>(in.teams.size(), in.slots.size()));
+  for (unsigned int t1 = 0; t1 < in.teams.size(); ++t1)
+    for (unsigned int t2 = 0; t2 < in.teams.size(); ++t2)
+      st.match[t1][t2] = in.slots.size();
     
   if (st.in.phased)
   {
@@ -444,10 +453,10 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
 #if defined(TBB_AVAILABLE) && defined(PARALLEL_GREEDY)
 )
       tbb::spin_mutex mx_best_state;
-      tbb::parallel_for_each(begin(source), end(source), [r, &best_cost, &best_solution, &best_index, &mx_best_state](const auto& state) {
+      tbb::parallel_for_each(begin(source), end(source), [this, r, &best_cost, &best_solution, &best_index, &mx_best_state](const auto& state) {
         float current_cost = state.first.GreedyCalculateCost(r);
         tbb::spin_mutex::scoped_lock  lock(mx_best_state);
-        if (current_cost < best_cost || (current_cost == best_cost && Random::Uniform(0, 1)))
+        if (current_cost < best_cost || (current_cost == best_cost && rng.Uniform(0, 1)))
         {
           best_solution = state.first;
           best_cost = current_cost;
@@ -458,7 +467,7 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
       for (auto state : source)
       {
         float current_cost = state.first.GreedyCalculateCost(r);
-        if (current_cost < best_cost || (current_cost == best_cost && Random::Uniform(0, 1)))
+        if (current_cost < best_cost || (current_cost == best_cost && rng.Uniform(0, 1)))
         {
           best_solution = state.first;
           best_cost = current_cost;
@@ -479,10 +488,10 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
       coroutine<std::pair<STT_Solution, size_t>>::pull_type source(std::bind(assign_candidate_at_round, std::placeholders::_1, r, st, candidate_tournament_second_leg));
 #if defined(TBB_AVAILABLE) && defined(PARALLEL_GREEDY)
       tbb::spin_mutex mx_best_state;
-      tbb::parallel_for_each(begin(source), end(source), [r, &best_cost, &best_solution, &best_index, &mx_best_state](const auto& state) {
+      tbb::parallel_for_each(begin(source), end(source), [this, r, &best_cost, &best_solution, &best_index, &mx_best_state](const auto& state) {
         float current_cost = state.first.GreedyCalculateCost(r);
         tbb::spin_mutex::scoped_lock  lock(mx_best_state);
-        if (current_cost < best_cost || (current_cost == best_cost && Random::Uniform(0, 1)))
+        if (current_cost < best_cost || (current_cost == best_cost && rng.Uniform(0, 1)))
         {
           best_solution = state.first;
           best_cost = current_cost;
@@ -493,7 +502,7 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
       for (auto state : source)
       {
         float current_cost = state.first.GreedyCalculateCost(r);
-        if (current_cost < best_cost || (current_cost == best_cost && Random::Uniform(0, 1)))
+        if (current_cost < best_cost || (current_cost == best_cost && rng.Uniform(0, 1)))
         {
           best_solution = state.first;
           best_cost = current_cost;
@@ -519,10 +528,10 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
       coroutine<std::pair<STT_Solution, size_t>>::pull_type source(std::bind(assign_candidate_at_round, std::placeholders::_1, r, st, candidate_tournament));
 #if defined(TBB_AVAILABLE) && defined(PARALLEL_GREEDY)
       tbb::spin_mutex mx_best_state;
-      tbb::parallel_for_each(begin(source), end(source), [r, &best_cost, &best_solution, &best_index, &mx_best_state](const auto& state) {
+      tbb::parallel_for_each(begin(source), end(source), [this, r, &best_cost, &best_solution, &best_index, &mx_best_state](const auto& state) {
         float current_cost = state.first.GreedyCalculateCost(r);
         tbb::spin_mutex::scoped_lock  lock(mx_best_state);
-        if (current_cost < best_cost || (current_cost == best_cost && Random::Uniform(0, 1)))
+        if (current_cost < best_cost || (current_cost == best_cost && rng.Uniform(0, 1)))
         {
           best_solution = state.first;
           best_cost = current_cost;
@@ -533,7 +542,7 @@ void STT_SolutionManager::GreedyState(STT_Solution& st)
       for (auto state : source)
       {
         float current_cost = state.first.GreedyCalculateCost(r);
-        if (current_cost < best_cost || (current_cost == best_cost && Random::Uniform(0, 1)))
+        if (current_cost < best_cost || (current_cost == best_cost && rng.Uniform(0, 1)))
         {
           best_solution = state.first;
           best_cost = current_cost;
@@ -1175,19 +1184,230 @@ void PhasedCostComponent::PrintViolations(const STT_Solution& st, std::ostream&
 
 
 
+/***************************************************************************
+ * Move application (shared by the explorers and the delta cost components):
+ * State is either STT_Solution or STT_SolutionOverlay. The is_return_match
+ * fixups are not part of it, as they do not affect the costs.
+ ***************************************************************************/
+
+template <class State>
+static void ApplyMove(State& st, const STT_SwapHomes& m)
+{
+  st.InternalMakeSwapHomes(m.t1, m.t2);
+}
+
+template <class State>
+static void ApplyMove(State& st, const STT_SwapTeams& m)
+{
+  for(unsigned r = 0; r < st.in.slots.size(); r++)
+    //      if(st.opp[m.t1][r] != m.t2) // not the round of the t1-t2 match  // REMOVED 20-7-2005
+    st.UpdateMatches(m.t1,m.t2,r);
+}
+
+template <class State>
+static void ApplyMove(State& st, const STT_SwapRounds& m)
+{
+  unsigned t, t1, t2;
+  bool b1, b2;
+  for (t = 0; t < st.in.teams.size(); t++)
+  {
+    t1 = st.Opponent(t,m.r1);
+    t2 = st.Opponent(t,m.r2);
+    b1 = st.Home(t,m.r1); 
+    b2 = st.Home(t,m.r2);
+    st.UpdateStateCell(t,m.r1,t2,b2);
+    st.UpdateStateCell(t,m.r2,t1,b1);
+    // NOTE: it is crucial to store st.Home(t,m.r1) in b1, because the first call of UpdateStateCell changes its value
+  }
+}
+
+template <class State>
+static void ApplyMove(State& st, const STT_SwapMatchesNotPhased& m)
+{
+  for(unsigned int r = 0; r < m.rs.size(); r++)
+  {
+    st.UpdateMatches(m.t1,m.t2,m.rs[r]);
+  }
+}
+
+template <class State>
+static void ApplyMove(State& st, const STT_SwapMatchesPhased& m)
+{
+  for(unsigned int r = 0; r < m.rs.size(); r++)
+  {
+    st.UpdateMatches(m.t1,m.t2, m.rs[r], ((m.swap_homes_t2 >> r) & 1) != 0, ((m.swap_homes_t1 >> r) & 1) != 0);
+  }
+}
+
+template <class State>
+static void ApplyMove(State& st, const STT_SwapMatchRound& m)
+{
+  unsigned t1, t2;
+  bool b1, b2;
+  for (unsigned int t = 0; t < m.ts.size(); t++)
+  {
+    t1 = st.Opponent(m.ts[t],m.r1);
+    t2 = st.Opponent(m.ts[t],m.r2);
+    b1 = st.Home(m.ts[t],m.r1); 
+    b2 = st.Home(m.ts[t],m.r2);
+    st.UpdateStateCell(m.ts[t],m.r1,t2,b2);
+    st.UpdateStateCell(m.ts[t],m.r2,t1,b1);
+  }
+}
+
+// key of a move for the overlay: the neighborhood and all the data read by ApplyMove
+static void MoveKey(const STT_SwapHomes& m, vector<unsigned>& key)
+{
+  key.assign({0, m.t1, m.t2});
+}
+
+static void MoveKey(const STT_SwapTeams& m, vector<unsigned>& key)
+{
+  key.assign({1, m.t1, m.t2});
+}
+
+static void MoveKey(const STT_SwapRounds& m, vector<unsigned>& key)
+{
+  key.assign({2, m.r1, m.r2});
+}
+
+static void MoveKey(const STT_SwapMatchesNotPhased& m, vector<unsigned>& key)
+{
+  key.assign({3, m.t1, m.t2});
+  for (unsigned r = 0; r < m.rs.size(); r++)
+    key.push_back(m.rs[r]);
+}
+
+static void MoveKey(const STT_SwapMatchesPhased& m, vector<unsigned>& key)
+{
+  key.assign({4, m.t1, m.t2, unsigned(m.swap_homes_t1), unsigned(m.swap_homes_t1 >> 32),
+              unsigned(m.swap_homes_t2), unsigned(m.swap_homes_t2 >> 32)});
+  for (unsigned r = 0; r < m.rs.size(); r++)
+    key.push_back(m.rs[r]);
+}
+
+static void MoveKey(const STT_SwapMatchRound& m, vector<unsigned>& key)
+{
+  key.assign({5, m.r1, m.r2});
+  for (unsigned t = 0; t < m.ts.size(); t++)
+    key.push_back(m.ts[t]);
+}
+
+// simulates m on the overlay of st, unless the overlay already holds its simulation on the current state
+// (so the move is simulated once for FeasibleMove and all the delta cost components)
+template <class Move>
+static void Simulate(const STT_Solution& st, const Move& m)
+{
+  STT_SolutionOverlay& ov = st.overlay;
+  MoveKey(m, ov.move_key);
+  if (ov.simulated_version == st.state_version && ov.move_key == ov.simulated_move)
+    return;
+  ov.Reset();
+  ApplyMove(ov, m);
+  ov.simulated_move.swap(ov.move_key);
+  ov.simulated_version = st.state_version;
+}
+
+/***************************************************************************
+ * METHODS FOR the Delta Cost Components:
+ * the move is simulated on the overlay of st (once for all the components),
+ * and only the constraints touching the cells it writes are evaluated
+ ***************************************************************************/
+
+template <class Move>
+int STT_DeltaCostComponent<Move>::ComputeDeltaCost(const STT_Solution& st, const Move& m) const
+{
+  Simulate(st, m);
+  return st.CalculateDeltaCostComponent(st.overlay, c_type);
+}
+
+template <class Move>
+int STT_PhasedDeltaCostComponent<Move>::ComputeDeltaCost(const STT_Solution& st, const Move& m) const
+{
+  Simulate(st, m);
+  return st.CalculateDeltaCostPhased(st.overlay);
+}
+
+template <class Move>
+bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const Move& m, double temperature, int& delta, unsigned& evaluated)
+{
+  double u = rng.Uniform<double>(0.0, 1.0);
+  double threshold = u > 0.0 ? -temperature * log(u) : numeric_limits<double>::infinity();
+  Simulate(st, m);
+  return st.CalculateDeltaCostBounded(st.overlay, threshold, delta, evaluated);
+}
+
+template bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const STT_SwapHomes& m, double temperature, int& delta, unsigned& evaluated);
+template bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const STT_SwapTeams& m, double temperature, int& delta, unsigned& evaluated);
+template bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const STT_SwapRounds& m, double temperature, int& delta, unsigned& evaluated);
+template bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const STT_SwapMatchesNotPhased& m, double temperature, int& delta, unsigned& evaluated);
+template bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const STT_SwapMatchesPhased& m, double temperature, int& delta, unsigned& evaluated);
+template bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const STT_SwapMatchRound& m, double temperature, int& delta, unsigned& evaluated);
+
+template <class NE>
+unsigned STT_CheckDeltaCosts(const NE& ne, STT_Solution& st, unsigned moves, ostream& os)
+{
+  unsigned mismatches = 0;
+  int cost = st.CalculateFullCost();
+  for (unsigned i = 0; i < moves; i++)
+  {
+    typename NE::MoveType m;
+    try
+    {
+      ne.RandomMove(st, m);
+    }
+    catch (EmptyNeighborhood&)
+    {
+      continue;
+    }
+    Simulate(st, m);
+    int delta = st.CalculateDeltaCostPhased(st.overlay), bounded_delta;
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+      delta += st.CalculateDeltaCostComponent(st.overlay, c_type);
+    unsigned evaluated;
+    st.CalculateDeltaCostBounded(st.overlay, numeric_limits<double>::infinity(), bounded_delta, evaluated);
+    ne.MakeMove(st, m);
+    int cost_after_move = st.ReturnTotalCost();
+    int full_cost = st.CalculateFullCost();
+    if (delta != full_cost - cost || bounded_delta != full_cost - cost || cost_after_move != full_cost)
+    {
+      os << "Move " << m << ": delta " << delta << ", bounded delta " << bounded_delta << ", cost after MakeMove " << cost_after_move
+         << ", full cost " << full_cost << " (before the move " << cost << ")" << endl;
+      mismatches++;
+    }
+    cost = full_cost;
+  }
+  return mismatches;
+}
+
+template class STT_DeltaCostComponent<STT_SwapHomes>;
+template class STT_DeltaCostComponent<STT_SwapTeams>;
+template class STT_DeltaCostComponent<STT_SwapRounds>;
+template class STT_DeltaCostComponent<STT_SwapMatchesNotPhased>;
+template class STT_DeltaCostComponent<STT_SwapMatchesPhased>;
+template class STT_DeltaCostComponent<STT_SwapMatchRound>;
+template class STT_PhasedDeltaCostComponent<STT_SwapHomes>;
+template class STT_PhasedDeltaCostComponent<STT_SwapTeams>;
+template class STT_PhasedDeltaCostComponent<STT_SwapRounds>;
+template class STT_PhasedDeltaCostComponent<STT_SwapMatchesNotPhased>;
+template class STT_PhasedDeltaCostComponent<STT_SwapMatchesPhased>;
+template class STT_PhasedDeltaCostComponent<STT_SwapMatchRound>;
+
 /***************************************************************************
  * 1  METHODS FOR STT_SwapHomes Neighborhood Explorer:
  ***************************************************************************/
 
-STT_SwapHomesNeighborhoodExplorer::STT_SwapHomesNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm)
-  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapHomes>(in,sm,"STT_SwapHomesNeighborhoodExplorer")
+STT_SwapHomesNeighborhoodExplorer::STT_SwapHomesNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng)
+  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapHomes>(in,sm,"STT_SwapHomesNeighborhoodExplorer"), rng(rng)
 {
 }
 void STT_SwapHomesNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, STT_SwapHomes& m) const
 {
-  m.t1 = Random::Uniform<int>(0,in.teams.size()-1);
+  unsigned s;
+  if (!GuidedTeamAndSlot(rng, st, m.t1, s))
+    m.t1 = rng.Uniform<int>(0,in.teams.size()-1);
   do 
-    m.t2 = Random::Uniform<int>(0,in.teams.size()-1);
+    m.t2 = rng.Uniform<int>(0,in.teams.size()-1);
   while (m.t1 == m.t2);
   if (m.t1 > m.t2)
     swap(m.t1,m.t2);
@@ -1220,19 +1440,9 @@ bool STT_SwapHomesNeighborhoodExplorer::FeasibleMove(const STT_Solution& st, con
   {
     if(st.in.forbid_hard_worsening_moves) //se siamo nel secondo stage
     {
-      STT_Solution st_copy(st.in);
-      st_copy = st;
-      ExecuteMove(st_copy, m);
-      for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
-      {
-        for(unsigned int k = 0; k < st_copy.in.constraints_hard_indexes[c_type].size(); k++)
-        {
-          if(st_copy.CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), st_copy.in.constraints_hard_indexes[c_type][k]) > 0)
-          {
-            return false;
-          }
-        }
-      }
+      //SIMULO LA MOSSA sull'overlay, senza copiare lo stato, e controllo solo le constraints hard coinvolte
+      Simulate(st, m);
+      return st.HardFeasible(st.overlay);
     }
     return true;
   }
@@ -1241,75 +1451,28 @@ bool STT_SwapHomesNeighborhoodExplorer::FeasibleMove(const STT_Solution& st, con
 
 void STT_SwapHomesNeighborhoodExplorer::ExecuteMove(STT_Solution& st,const STT_SwapHomes& m) const
 {
-  st.InternalMakeSwapHomes(m.t1, m.t2);
+  ApplyMove(st, m);
 }
 
 void STT_SwapHomesNeighborhoodExplorer::MakeMove(STT_Solution& st,const STT_SwapHomes& m) const
 {   
-  vector<vector<unsigned int>> involved_constraints(N_CONSTRAINTS, vector<unsigned>(0,0));
-  bool already_in_vector;
-
-
+  st.involved_constraints.Clear();
   for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
   {
-
     // [m.t1][match[m.t1][m.t2]]
-    involved_constraints[c_type] = in.team_slot_constraints[c_type][m.t1][st.match[m.t1][m.t2]];
-
-
+    st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t1, st.match[m.t1][m.t2]));
     // [m.t2][match[m.t1][m.t2]]
-    for (unsigned int i = 0; i<in.team_slot_constraints[c_type][m.t2][st.match[m.t1][m.t2]].size(); i++)
-    {
-      already_in_vector = false;
-      for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-      {
-        if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t2][st.match[m.t1][m.t2]][i])
-        {
-          already_in_vector = true;
-          break;
-        }
-      }
-      if(!already_in_vector)
-        involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t2][st.match[m.t1][m.t2]][i]);
-    }
-
+    st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t2, st.match[m.t1][m.t2]));
     // [m.t1][match[m.t2][m.t1]]
-    for (unsigned int i = 0; i<in.team_slot_constraints[c_type][m.t1][st.match[m.t2][m.t1]].size(); i++)
-    {
-      already_in_vector = false;
-      for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-      {
-        if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t1][st.match[m.t2][m.t1]][i])
-        {
-          already_in_vector = true;
-          break;
-        }
-      }
-      if(!already_in_vector)
-        involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t1][st.match[m.t2][m.t1]][i]);
-    }
-
+    st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t1, st.match[m.t2][m.t1]));
     // [m.t2][match[m.t2][m.t1]]
-    for (unsigned int i = 0; i<in.team_slot_constraints[c_type][m.t2][st.match[m.t2][m.t1]].size(); i++)
-    {
-      already_in_vector = false;
-      for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-      {
-        if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t2][st.match[m.t2][m.t1]][i])
-        {
-          already_in_vector = true;
-          break;
-        }
-      }
-      if(!already_in_vector)
-        involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t2][st.match[m.t2][m.t1]][i]);
-    }
+    st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t2, st.match[m.t2][m.t1]));
   }
 
   ExecuteMove(st, m);
 
-  st.UpdateSelectionedCostsConstraints(involved_constraints);
-  st.CalculateCostPhased();
+  st.UpdateSelectionedCostsConstraints(st.involved_constraints.Constraints());
+  st.UpdateCostPhased();
 
 
   st.UpdateMoveCounterAndBestSolution(st.ReturnTotalCost());
@@ -1345,16 +1508,18 @@ bool STT_SwapHomesNeighborhoodExplorer::NextMove(const STT_Solution& st, STT_Swa
  * 2 METHODS FOR STT_SwapTeams Neighborhood Explorer:
  ***************************************************************************/
 
-STT_SwapTeamsNeighborhoodExplorer::STT_SwapTeamsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm)
-    : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapTeams>(in,sm,"SwapTeamsNeighborhoodExplorer")
+STT_SwapTeamsNeighborhoodExplorer::STT_SwapTeamsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng)
+    : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapTeams>(in,sm,"SwapTeamsNeighborhoodExplorer"), rng(rng)
 {
 }
   
 void STT_SwapTeamsNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, STT_SwapTeams& m) const
 {
-  m.t1 = Random::Uniform<int>(0,in.teams.size()-1);
+  unsigned s;
+  if (!GuidedTeamAndSlot(rng, st, m.t1, s))
+    m.t1 = rng.Uniform<int>(0,in.teams.size()-1);
   do 
-    m.t2 = Random::Uniform<int>(0,in.teams.size()-1);
+    m.t2 = rng.Uniform<int>(0,in.teams.size()-1);
   while (m.t1 == m.t2);
   if (m.t1 > m.t2)
     swap(m.t1,m.t2);
@@ -1387,21 +1552,9 @@ bool STT_SwapTeamsNeighborhoodExplorer::FeasibleMove(const STT_Solution& st, con
   {
     if(st.in.forbid_hard_worsening_moves) //se siamo nel secondo stage
     {
-      STT_Solution st_copy(st.in);
-      st_copy = st;
-      //SIMULO LA MOSSA
-      ExecuteMove(st_copy, m);
-      //FINE SUMULAZIONE MOSSA
-      for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
-      {
-        for(unsigned int k = 0; k < st_copy.in.constraints_hard_indexes[c_type].size(); k++)
-        {
-          if(st_copy.CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), st_copy.in.constraints_hard_indexes[c_type][k]) > 0)
-          {
-            return false;
-          }
-        }
-      }
+      //SIMULO LA MOSSA sull'overlay, senza copiare lo stato, e controllo solo le constraints hard coinvolte
+      Simulate(st, m);
+      return st.HardFeasible(st.overlay);
     }
     return true;
   }
@@ -1412,9 +1565,7 @@ void STT_SwapTeamsNeighborhoodExplorer::ExecuteMove(STT_Solution& st,const STT_S
 {
   unsigned r;
 
-  for(r = 0; r < in.slots.size(); r++)
-    //      if(st.opp[m.t1][r] != m.t2) // not the round of the t1-t2 match  // REMOVED 20-7-2005
-    st.UpdateMatches(m.t1,m.t2,r);
+  ApplyMove(st, m);
   
   for(r = 0; r < in.slots.size(); r++)
   {
@@ -1432,29 +1583,15 @@ void STT_SwapTeamsNeighborhoodExplorer::MakeMove(STT_Solution& st,const STT_Swap
   //per STT_SwapTeams carichiamo le constraints relative ai team t1 e t2, a tutti gli slots
   //NOTA: forse dovrei considerare anche gli oppoentni di t1 e t2 nei relativi slots in cui viene effettuato 
   //lo scambio? Risposta: NO, non è necessario
-  vector<vector<unsigned int>> involved_constraints(N_CONSTRAINTS, vector<unsigned>(0,0));
-  bool already_in_vector;
+  st.involved_constraints.Clear();
   for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
   {
-    involved_constraints[c_type] = in.team_constraints[c_type][m.t1];
-    for (unsigned int i = 0; i<in.team_constraints[c_type][m.t2].size(); i++)
-    {
-      already_in_vector = false;
-      for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-      {
-        if(involved_constraints[c_type][j] == in.team_constraints[c_type][m.t2][i])
-        {
-          already_in_vector = true;
-          break;
-        }
-      }
-      if(!already_in_vector)
-        involved_constraints[c_type].push_back(in.team_constraints[c_type][m.t2][i]);
-    }
+    st.involved_constraints.Add(c_type, in.TeamConstraints(c_type, m.t1));
+    st.involved_constraints.Add(c_type, in.TeamConstraints(c_type, m.t2));
   }
 
-  st.UpdateSelectionedCostsConstraints(involved_constraints);
-  st.CalculateCostPhased();
+  st.UpdateSelectionedCostsConstraints(st.involved_constraints.Constraints());
+  st.UpdateCostPhased();
 
 
   st.UpdateMoveCounterAndBestSolution(st.ReturnTotalCost());
@@ -1492,14 +1629,16 @@ bool STT_SwapTeamsNeighborhoodExplorer::NextMove(const STT_Solution& st, STT_Swa
  * 3 METHODS FOR STT_SwapRounds Neighborhood Explorer:
  ***************************************************************************/
 
-STT_SwapRoundsNeighborhoodExplorer::STT_SwapRoundsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm)
-  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapRounds>(in,sm,"STT_SwapRoundsNeighborhoodExplorer")
+STT_SwapRoundsNeighborhoodExplorer::STT_SwapRoundsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng)
+  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapRounds>(in,sm,"STT_SwapRoundsNeighborhoodExplorer"), rng(rng)
 {
 }
 
 void STT_SwapRoundsNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, STT_SwapRounds& m) const
 {
-    m.r1 = Random::Uniform<int>(0,in.slots.size()-1);
+    unsigned t;
+    if (!GuidedTeamAndSlot(rng, st, t, m.r1))
+      m.r1 = rng.Uniform<int>(0,in.slots.size()-1);
 
     //NOTA: se sono nel caso in cui non voglio mischiare le fasi
     if(!st.in.mix_phase_during_search)
@@ -1507,20 +1646,20 @@ void STT_SwapRoundsNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, S
       //estraggo un valore solo sulla STESSA metà slots
       if (m.r1 < in.slots.size()/2)  // first leg
         {
-          m.r2 = Random::Uniform<int>(0,in.slots.size()/2-2);
+          m.r2 = rng.Uniform<int>(0,in.slots.size()/2-2);
           if (m.r2 >= m.r1)
             m.r2++;
         }
       else
         {
-          m.r2 = Random::Uniform<int>(in.slots.size()/2, in.slots.size() - 2);
+          m.r2 = rng.Uniform<int>(in.slots.size()/2, in.slots.size() - 2);
           if (m.r2 >= m.r1)
             m.r2++;
         }
     }
     else
     {
-       m.r2 = Random::Uniform<int>(0,in.slots.size()-2);
+       m.r2 = rng.Uniform<int>(0,in.slots.size()-2);
        if (m.r2 >= m.r1)
           m.r2++;
     }
@@ -1556,21 +1695,9 @@ bool STT_SwapRoundsNeighborhoodExplorer::FeasibleMove(const STT_Solution& st, co
   {
     if(st.in.forbid_hard_worsening_moves) //se siamo nel secondo stage
     {
-      STT_Solution st_copy(st.in);
-      st_copy = st;
-      //SIMULO LA MOSSA
-      ExecuteMove(st_copy, m);
-      //FINE SUMULAZIONE MOSSA
-      for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
-      {
-        for(unsigned int k = 0; k < st_copy.in.constraints_hard_indexes[c_type].size(); k++)
-        {
-          if(st_copy.CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), st_copy.in.constraints_hard_indexes[c_type][k]) > 0)
-          {
-            return false;
-          }
-        }
-      }
+      //SIMULO LA MOSSA sull'overlay, senza copiare lo stato, e controllo solo le constraints hard coinvolte
+      Simulate(st, m);
+      return st.HardFeasible(st.overlay);
     }
     return true;
   }
@@ -1580,18 +1707,9 @@ bool STT_SwapRoundsNeighborhoodExplorer::FeasibleMove(const STT_Solution& st, co
 
 void STT_SwapRoundsNeighborhoodExplorer::ExecuteMove(STT_Solution& st,const STT_SwapRounds& m) const
 {
-  unsigned t, t1, t2;
-  bool b1, b2;
-  for (t = 0; t < in.teams.size(); t++)
-  {
-    t1 = st.opponent[t][m.r1];
-    t2 = st.opponent[t][m.r2];
-    b1 = st.home[t][m.r1]; 
-    b2 = st.home[t][m.r2];
-    st.UpdateStateCell(t,m.r1,t2,b2);
-    st.UpdateStateCell(t,m.r2,t1,b1);
-    // NOTE: it is crucial to store st.home[t][m.r1] in b1, because the first call of UpdateStateCell changes its value
-  }
+  unsigned t;
+
+  ApplyMove(st, m);
 
   for (t = 0; t < in.teams.size(); t++)
   {
@@ -1607,29 +1725,15 @@ void STT_SwapRoundsNeighborhoodExplorer::MakeMove(STT_Solution& st,const STT_Swa
 
   //Carico in un vettore tutte le constraints da ricalcolare
   //per STT_SwapRounds carichiamo le constraints relative a tutti i team, agli slots r1 e r2
-  vector<vector<unsigned int>> involved_constraints(N_CONSTRAINTS, vector<unsigned>(0,0));
-  bool already_in_vector;
+  st.involved_constraints.Clear();
   for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
   {
-    involved_constraints[c_type] = in.slot_constraints[c_type][m.r1];
-    for (unsigned int i = 0; i<in.slot_constraints[c_type][m.r2].size(); i++)
-    {
-      already_in_vector = false;
-      for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-      {
-        if(involved_constraints[c_type][j] == in.slot_constraints[c_type][m.r2][i])
-        {
-          already_in_vector = true;
-          break;
-        }
-      }
-      if(!already_in_vector)
-        involved_constraints[c_type].push_back(in.slot_constraints[c_type][m.r2][i]);
-    }
+    st.involved_constraints.Add(c_type, in.SlotConstraints(c_type, m.r1));
+    st.involved_constraints.Add(c_type, in.SlotConstraints(c_type, m.r2));
   }
 
-  st.UpdateSelectionedCostsConstraints(involved_constraints);
-  st.CalculateCostPhased();
+  st.UpdateSelectionedCostsConstraints(st.involved_constraints.Constraints());
+  st.UpdateCostPhased();
 
 
   st.UpdateMoveCounterAndBestSolution(st.ReturnTotalCost());
@@ -1667,8 +1771,8 @@ bool STT_SwapRoundsNeighborhoodExplorer::NextMove(const STT_Solution& st, STT_Sw
  * 4 METHODS FOR STT_SwapMatchesNotPhased Neighborhood Explorer:
  ***************************************************************************/
 
-STT_SwapMatchesNotPhasedNeighborhoodExplorer::STT_SwapMatchesNotPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm)
-  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchesNotPhased>(in,sm,"STT_SwapMatchesNotPhasedNeighborhoodExplorer")
+STT_SwapMatchesNotPhasedNeighborhoodExplorer::STT_SwapMatchesNotPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng)
+  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchesNotPhased>(in,sm,"STT_SwapMatchesNotPhasedNeighborhoodExplorer"), rng(rng)
 {
   max_move_length = max(8,static_cast<int>(in.slots.size()/2));
   max_move_lenght_partial_cost_components = 8;
@@ -1694,12 +1798,24 @@ void STT_SwapMatchesNotPhasedNeighborhoodExplorer::RandomMove(const STT_Solution
 
 void STT_SwapMatchesNotPhasedNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, STT_SwapMatchesNotPhased& m) const
 {
-  m.t1 = Random::Uniform<int>(0,in.teams.size()-1);
+  unsigned r;
+  if (GuidedTeamAndSlot(rng, st, m.t1, r))
+  {
+    // the round is kept, therefore t2 must not be the opponent of t1 in it
+    do 
+      m.t2 = rng.Uniform<int>(0,in.teams.size()-1);
+    while (m.t1 == m.t2 || st.opponent[m.t1][r] == m.t2);
+    m.rs[0] = r;
+    if (m.t1 > m.t2)
+      swap(m.t1,m.t2);
+    return;
+  }
+  m.t1 = rng.Uniform<int>(0,in.teams.size()-1);
   do 
-    m.t2 = Random::Uniform<int>(0,in.teams.size()-1);
+    m.t2 = rng.Uniform<int>(0,in.teams.size()-1);
   while (m.t1 == m.t2);
   do // avoid the rounds in which t1 and t2 play each other
-    m.rs[0] = Random::Uniform<int>(0,in.slots.size()-1);
+    m.rs[0] = rng.Uniform<int>(0,in.slots.size()-1);
   while (st.opponent[m.t1][m.rs[0]] == m.t2);
   if (m.t1 > m.t2)
     swap(m.t1,m.t2);
@@ -1716,45 +1832,18 @@ bool STT_SwapMatchesNotPhasedNeighborhoodExplorer::FeasibleMove(const STT_Soluti
   {
     if(st.in.forbid_hard_worsening_moves) //se siamo nel secondo stage
     {
-      STT_Solution st_copy(st.in);
-      st_copy = st;
-      //SIMULO LA MOSSA
-      FastExecuteMove(st_copy, m);
-      //FINE SUMULAZIONE MOSSA
-      for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
-      {
-        for(unsigned int k = 0; k < st_copy.in.constraints_hard_indexes[c_type].size(); k++)
-        {
-          if(st_copy.CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), st_copy.in.constraints_hard_indexes[c_type][k]) > 0)
-          {
-            return false;
-          }
-        }
-      }
+      //SIMULO LA MOSSA sull'overlay, senza copiare lo stato, e controllo solo le constraints hard coinvolte
+      Simulate(st, m);
+      return st.HardFeasible(st.overlay);
     }
     return true;
   }
   return false;
 }
 
-void STT_SwapMatchesNotPhasedNeighborhoodExplorer::FastExecuteMove(STT_Solution& st,const STT_SwapMatchesNotPhased& m) const
-{
-  for(unsigned int r = 0; r < m.rs.size(); r++)
-  {
-    st.UpdateMatches(m.t1,m.t2,m.rs[r]);
-  }
-  for(unsigned int r = 0; r < m.rs.size(); r++)
-  {
-    st.PopulateCellInsideIsReturnMatrixAndFixRelatedMatches(m.t1,m.rs[r]);
-    st.PopulateCellInsideIsReturnMatrixAndFixRelatedMatches(m.t2,m.rs[r]);
-  }
-}
-
 void STT_SwapMatchesNotPhasedNeighborhoodExplorer::MakeMove(STT_Solution& st,const STT_SwapMatchesNotPhased& m) const
 {
-    vector<vector<unsigned int>> involved_constraints(N_CONSTRAINTS, vector<unsigned>(0,0));
-    bool already_in_vector;
-  
+    st.involved_constraints.Clear();
 
     for(unsigned int r = 0; r < m.rs.size(); r++)
     {
@@ -1769,36 +1858,9 @@ void STT_SwapMatchesNotPhasedNeighborhoodExplorer::MakeMove(STT_Solution& st,con
         for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
         {
           // [m.t1][m.rs[r]]
-          for (unsigned int i = 0; i < in.team_slot_constraints[c_type][m.t1][m.rs[r]].size(); i++)
-          {
-            already_in_vector = false;
-            for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-            {
-              if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t1][m.rs[r]][i])
-              {
-                already_in_vector = true;
-                break;
-              }
-            }
-            if(!already_in_vector)
-              involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t1][m.rs[r]][i]);
-          }
-
+          st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t1, m.rs[r]));
           // [m.t2][m.rs[r]]
-          for (unsigned int i = 0; i<in.team_slot_constraints[c_type][m.t2][m.rs[r]].size(); i++)
-          {
-            already_in_vector = false;
-            for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-            {
-              if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t2][m.rs[r]][i])
-              {
-                already_in_vector = true;
-                break;
-              }
-            }
-            if(!already_in_vector)
-            involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t2][m.rs[r]][i]);
-          }
+          st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t2, m.rs[r]));
         }
       }
       st.UpdateMatches(m.t1,m.t2,m.rs[r]);
@@ -1813,8 +1875,8 @@ void STT_SwapMatchesNotPhasedNeighborhoodExplorer::MakeMove(STT_Solution& st,con
 
     if(m.rs.size()<=max_move_lenght_partial_cost_components)
     {
-      st.UpdateSelectionedCostsConstraints(involved_constraints);
-      st.CalculateCostPhased();
+      st.UpdateSelectionedCostsConstraints(st.involved_constraints.Constraints());
+      st.UpdateCostPhased();
     }
     else
     {
@@ -1933,8 +1995,8 @@ bool STT_SwapMatchesNotPhasedNeighborhoodExplorer::AnyNextMove(const STT_Solutio
  * 5 METHODS FOR STT_SwapMatchesPhased Neighborhood Explorer:
  ***************************************************************************/
 
-STT_SwapMatchesPhasedNeighborhoodExplorer::STT_SwapMatchesPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm)
-  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchesPhased>(in,sm,"STT_SwapMatchesPhasedNeighborhoodExplorer")
+STT_SwapMatchesPhasedNeighborhoodExplorer::STT_SwapMatchesPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng)
+  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchesPhased>(in,sm,"STT_SwapMatchesPhasedNeighborhoodExplorer"), rng(rng)
 {
   max_move_length = max(8,static_cast<int>(in.slots.size()/2));
   max_move_lenght_partial_cost_components = 0; //NEEDS TO BE ZERO UNTIL BUG ON PARTIAL COSTS ON STT_SwapMatchesPhased IS SOLVED
@@ -1957,12 +2019,28 @@ void STT_SwapMatchesPhasedNeighborhoodExplorer::RandomMove(const STT_Solution& s
 
 void STT_SwapMatchesPhasedNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, STT_SwapMatchesPhased& m) const
 {
-  m.t1 = Random::Uniform<int>(0,in.teams.size()-1);
+  unsigned r;
+  if (GuidedTeamAndSlot(rng, st, m.t1, r))
+  {
+    // the round is kept, a suitable t2 might not exist: after a few attempts the move is drawn uniformly
+    for (unsigned attempt = 0; attempt < in.teams.size(); attempt++)
+    {
+      m.t2 = rng.Uniform<int>(0,in.teams.size()-1);
+      if (m.t1 != m.t2 && st.opponent[m.t1][r] != m.t2 && st.is_return_match[m.t1][r] == st.is_return_match[m.t2][r])
+      {
+        m.rs[0] = r;
+        if (m.t1 > m.t2)
+          swap(m.t1,m.t2);
+        return;
+      }
+    }
+  }
+  m.t1 = rng.Uniform<int>(0,in.teams.size()-1);
   do 
-    m.t2 = Random::Uniform<int>(0,in.teams.size()-1);
+    m.t2 = rng.Uniform<int>(0,in.teams.size()-1);
   while (m.t1 == m.t2);
   do // avoid the rounds in which t1 and t2 play each other
-    m.rs[0] = Random::Uniform<int>(0,in.slots.size()-1);
+    m.rs[0] = rng.Uniform<int>(0,in.slots.size()-1);
   while (st.opponent[m.t1][m.rs[0]] == m.t2 || st.is_return_match[m.t1][m.rs[0]] != st.is_return_match[m.t2][m.rs[0]]);
   if (m.t1 > m.t2)
     swap(m.t1,m.t2);
@@ -1980,44 +2058,18 @@ bool STT_SwapMatchesPhasedNeighborhoodExplorer::FeasibleMove(const STT_Solution&
   {
     if(st.in.forbid_hard_worsening_moves) //se siamo nel secondo stage
     {
-      STT_Solution st_copy(st.in);
-      st_copy = st;
-      //SIMULO LA MOSSA
-      FastExecuteMove(st_copy, m);
-      //FINE SUMULAZIONE MOSSA
-      for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
-      {
-        for(unsigned int k = 0; k < st_copy.in.constraints_hard_indexes[c_type].size(); k++)
-        {
-          if(st_copy.CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), st_copy.in.constraints_hard_indexes[c_type][k]) > 0)
-          {
-            return false;
-          }
-        }
-      }
+      //SIMULO LA MOSSA sull'overlay, senza copiare lo stato, e controllo solo le constraints hard coinvolte
+      Simulate(st, m);
+      return st.HardFeasible(st.overlay);
     }
     return true;
   }
   return false;
 }
 
-void STT_SwapMatchesPhasedNeighborhoodExplorer::FastExecuteMove(STT_Solution& st,const STT_SwapMatchesPhased& m) const
-{
-  for(unsigned int r = 0; r < m.rs.size(); r++)
-  {
-    st.UpdateMatches(m.t1,m.t2, m.rs[r], m.swap_homes_t2[r], m.swap_homes_t1[r]);
-  }
-  for(unsigned int r = 0; r < m.rs.size(); r++)
-  {
-    st.PopulateCellInsideIsReturnMatrixAndFixRelatedMatches(m.t1,m.rs[r]);
-    st.PopulateCellInsideIsReturnMatrixAndFixRelatedMatches(m.t2,m.rs[r]);
-  }
-}
-
 void STT_SwapMatchesPhasedNeighborhoodExplorer::MakeMove(STT_Solution& st,const STT_SwapMatchesPhased& m) const
 {
-    vector<vector<unsigned int>> involved_constraints(N_CONSTRAINTS, vector<unsigned>(0,0));
-    bool already_in_vector;
+    st.involved_constraints.Clear();
 
     for(unsigned int r = 0; r < m.rs.size(); r++)
     {
@@ -2032,40 +2084,13 @@ void STT_SwapMatchesPhasedNeighborhoodExplorer::MakeMove(STT_Solution& st,const
         for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
         {
           // [m.t1][m.rs[r]]
-          for (unsigned int i = 0; i < in.team_slot_constraints[c_type][m.t1][m.rs[r]].size(); i++)
-          {
-            already_in_vector = false;
-            for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-            {
-              if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t1][m.rs[r]][i])
-              {
-                already_in_vector = true;
-                break;
-              }
-            }
-            if(!already_in_vector)
-              involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t1][m.rs[r]][i]);
-          }
-
+          st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t1, m.rs[r]));
           // [m.t2][m.rs[r]]
-          for (unsigned int i = 0; i<in.team_slot_constraints[c_type][m.t2][m.rs[r]].size(); i++)
-          {
-            already_in_vector = false;
-            for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-            {
-              if(involved_constraints[c_type][j] == in.team_slot_constraints[c_type][m.t2][m.rs[r]][i])
-              {
-                already_in_vector = true;
-                break;
-              }
-            }
-            if(!already_in_vector)
-            involved_constraints[c_type].push_back(in.team_slot_constraints[c_type][m.t2][m.rs[r]][i]);
-          }
+          st.involved_constraints.Add(c_type, in.TeamSlotConstraints(c_type, m.t2, m.rs[r]));
         }
       }
 
-      st.UpdateMatches(m.t1,m.t2, m.rs[r], m.swap_homes_t2[r], m.swap_homes_t1[r]);
+      st.UpdateMatches(m.t1,m.t2, m.rs[r], ((m.swap_homes_t2 >> r) & 1) != 0, ((m.swap_homes_t1 >> r) & 1) != 0);
     }
     for(unsigned int r = 0; r < m.rs.size(); r++)
     {
@@ -2075,8 +2100,8 @@ void STT_SwapMatchesPhasedNeighborhoodExplorer::MakeMove(STT_Solution& st,const
 
     if(m.rs.size()<=max_move_lenght_partial_cost_components)
     {
-      st.UpdateSelectionedCostsConstraints(involved_constraints);
-      st.CalculateCostPhased();
+      st.UpdateSelectionedCostsConstraints(st.involved_constraints.Constraints());
+      st.UpdateCostPhased();
     }
     else
     {
@@ -2104,10 +2129,8 @@ bool STT_SwapMatchesPhasedNeighborhoodExplorer::ComputeAndCheckInvolvedRounds(co
     t_stop = st.opponent[m.t1][r];
     t = st.opponent[m.t2][r];
     m.rs.resize(1);
-    m.swap_homes_t1[0] = false;
-    m.swap_homes_t2[0] = false;
-    m.swap_homes_t1.resize(1);
-    m.swap_homes_t2.resize(1);
+    m.swap_homes_t1 = 0;
+    m.swap_homes_t2 = 0;
 
 
     //devo calcolarlo anche al turno 0
@@ -2115,14 +2138,14 @@ bool STT_SwapMatchesPhasedNeighborhoodExplorer::ComputeAndCheckInvolvedRounds(co
     {
       if(st.IsReturnMatch(m.t2,st.opponent[m.t1][m.rs[0]]) != st.IsReturnMatch(m.t1,st.opponent[m.t1][m.rs[0]]))
       {
-        m.swap_homes_t2[m.swap_homes_t2.size()-1] = true;
+        m.swap_homes_t2 |= uint64_t(1) << (m.rs.size() - 1);
       }
     }
     else  //se t1 gioca in trasferta, la nuova partita sarà 
     {
       if(st.IsReturnMatch(st.opponent[m.t1][m.rs[0]], m.t2) != st.IsReturnMatch(st.opponent[m.t1][m.rs[0]], m.t1))
       {
-        m.swap_homes_t2[m.swap_homes_t2.size()-1] = true;
+        m.swap_homes_t2 |= uint64_t(1) << (m.rs.size() - 1);
       }
     }
 
@@ -2130,14 +2153,14 @@ bool STT_SwapMatchesPhasedNeighborhoodExplorer::ComputeAndCheckInvolvedRounds(co
     {
       if(st.IsReturnMatch(m.t1,st.opponent[m.t2][m.rs[0]]) != st.IsReturnMatch(m.t2,st.opponent[m.t2][m.rs[0]]))
       {
-        m.swap_homes_t1[m.swap_homes_t1.size()-1] = true;
+        m.swap_homes_t1 |= uint64_t(1) << (m.rs.size() - 1);
       }
     }
     else  //se t1 gioca in trasferta, la nuova partita sarà 
     {
       if(st.IsReturnMatch(st.opponent[m.t2][m.rs[0]], m.t1) != st.IsReturnMatch(st.opponent[m.t2][m.rs[0]], m.t2))
       {
-        m.swap_homes_t1[m.swap_homes_t1.size()-1] = true;
+        m.swap_homes_t1 |= uint64_t(1) << (m.rs.size() - 1);
       }
     }
 
@@ -2173,36 +2196,33 @@ bool STT_SwapMatchesPhasedNeighborhoodExplorer::ComputeAndCheckInvolvedRounds(co
         }
 
         //se ho deciso di aggiungere un nuovo step alla repair chain, calcolo i valori di swap_homes_t1 e swap_homes_t2
-        m.swap_homes_t2.push_back(false);
         if(st.home[m.t1][r]) //se t1 gioca in casa, allora la nuova partita sarà t2 - opponent t1
         {
           if(st.IsReturnMatch(m.t2,st.opponent[m.t1][r]) != st.IsReturnMatch(m.t1,st.opponent[m.t1][r]))
           {
-            m.swap_homes_t2[m.swap_homes_t2.size()-1] = true;
+            m.swap_homes_t2 |= uint64_t(1) << (m.rs.size() - 1);
           }
         }
         else  //se t1 gioca in trasferta, la nuova partita sarà 
         {
           if(st.IsReturnMatch(st.opponent[m.t1][r], m.t2) != st.IsReturnMatch(st.opponent[m.t1][r], m.t1))
           {
-            m.swap_homes_t2[m.swap_homes_t2.size()-1] = true;
+            m.swap_homes_t2 |= uint64_t(1) << (m.rs.size() - 1);
           }
         }
 
-        m.swap_homes_t1.push_back(false);
-
         if(st.home[m.t2][r]) //se t2 gioca in casa, allora la nuova partita sarà t1 - opponent t2
         {
           if(st.IsReturnMatch(m.t1,st.opponent[m.t2][r]) != st.IsReturnMatch(m.t2,st.opponent[m.t2][r]))
           {
-            m.swap_homes_t1[m.swap_homes_t1.size()-1] = true;
+            m.swap_homes_t1 |= uint64_t(1) << (m.rs.size() - 1);
           }
         }
         else  //se t1 gioca in trasferta, la nuova partita sarà 
         {
           if(st.IsReturnMatch(st.opponent[m.t2][r], m.t1) != st.IsReturnMatch(st.opponent[m.t2][r], m.t2))
           {
-            m.swap_homes_t1[m.swap_homes_t1.size()-1] = true;
+            m.swap_homes_t1 |= uint64_t(1) << (m.rs.size() - 1);
           }
         }
 
@@ -2265,8 +2285,8 @@ bool STT_SwapMatchesPhasedNeighborhoodExplorer::AnyNextMove(const STT_Solution&
  * 6 METHODS FOR STT_SwapMatchRound Neighborhood Explorer:
  ***************************************************************************/
 
-STT_SwapMatchRoundNeighborhoodExplorer::STT_SwapMatchRoundNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm)
-  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchRound>(in,sm,"STT_SwapMatchRoundNeighborhoodExplorer")
+STT_SwapMatchRoundNeighborhoodExplorer::STT_SwapMatchRoundNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng)
+  : NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchRound>(in,sm,"STT_SwapMatchRoundNeighborhoodExplorer"), rng(rng)
 {
   //max_move_length = UINT_MAX;
   //max_move_length = 40;
@@ -2294,8 +2314,17 @@ void STT_SwapMatchRoundNeighborhoodExplorer::RandomMove(const STT_Solution& st,
 
 void STT_SwapMatchRoundNeighborhoodExplorer::AnyRandomMove(const STT_Solution& st, STT_SwapMatchRound& m) const
 {
-    m.ts[0] = Random::Uniform<int>(0,in.teams.size()-1);
-    m.r1 = Random::Uniform<int>(0,in.slots.size()-1);
+    unsigned t, r;
+    if (GuidedTeamAndSlot(rng, st, t, r))
+    {
+      m.ts[0] = t;
+      m.r1 = r;
+    }
+    else
+    {
+      m.ts[0] = rng.Uniform<int>(0,in.teams.size()-1);
+      m.r1 = rng.Uniform<int>(0,in.slots.size()-1);
+    }
     
     do
     {
@@ -2304,16 +2333,16 @@ void STT_SwapMatchRoundNeighborhoodExplorer::AnyRandomMove(const STT_Solution& s
         {
             if(m.r1<in.slots.size()/2)
             {
-                m.r2 = Random::Uniform<int>(0,in.slots.size()/2-1);
+                m.r2 = rng.Uniform<int>(0,in.slots.size()/2-1);
             }
             else
             {
-                m.r2 = Random::Uniform<int>(in.slots.size()/2,in.slots.size()-1);    
+                m.r2 = rng.Uniform<int>(in.slots.size()/2,in.slots.size()-1);    
             }
         }
         else
         {
-            m.r2 = Random::Uniform<int>(0,in.slots.size()-1);
+            m.r2 = rng.Uniform<int>(0,in.slots.size()-1);
         }
     } 
     while (m.r1 == m.r2); 
@@ -2327,21 +2356,9 @@ bool STT_SwapMatchRoundNeighborhoodExplorer::FeasibleMove(const STT_Solution& st
   {
     if(st.in.forbid_hard_worsening_moves) //se siamo nel secondo stage
     {
-      STT_Solution st_copy(st.in);
-      st_copy = st;
-      //SIMULO LA MOSSA
-      ExecuteMove(st_copy, m);
-      //FINE SUMULAZIONE MOSSA
-      for(unsigned int c_type = CA1; c_type <= SE1; c_type++)
-      {
-        for(unsigned int k = 0; k < st_copy.in.constraints_hard_indexes[c_type].size(); k++)
-        {
-          if(st_copy.CalculateCostSingleConstraint(static_cast<Constraints::ConstraintType>(c_type), st_copy.in.constraints_hard_indexes[c_type][k]) > 0)
-          {
-            return false;
-          }
-        }
-      }
+      //SIMULO LA MOSSA sull'overlay, senza copiare lo stato, e controllo solo le constraints hard coinvolte
+      Simulate(st, m);
+      return st.HardFeasible(st.overlay);
     }
     return true;
   }
@@ -2350,17 +2367,7 @@ bool STT_SwapMatchRoundNeighborhoodExplorer::FeasibleMove(const STT_Solution& st
 
 void STT_SwapMatchRoundNeighborhoodExplorer::ExecuteMove(STT_Solution& st,const STT_SwapMatchRound& m) const
 {
-  unsigned t1, t2;
-  bool b1, b2;
-  for (unsigned int t = 0; t < m.ts.size(); t++)
-  {
-    t1 = st.opponent[m.ts[t]][m.r1];
-    t2 = st.opponent[m.ts[t]][m.r2];
-    b1 = st.home[m.ts[t]][m.r1]; 
-    b2 = st.home[m.ts[t]][m.r2];
-    st.UpdateStateCell(m.ts[t],m.r1,t2,b2);
-    st.UpdateStateCell(m.ts[t],m.r2,t1,b1);
-  }
+  ApplyMove(st, m);
 
   for (unsigned int t = 0; t < m.ts.size(); t++)
   {
@@ -2371,35 +2378,20 @@ void STT_SwapMatchRoundNeighborhoodExplorer::ExecuteMove(STT_Solution& st,const
 
 void STT_SwapMatchRoundNeighborhoodExplorer::MakeMove(STT_Solution& st,const STT_SwapMatchRound& m) const
 {
-  vector<vector<unsigned int>> involved_constraints(N_CONSTRAINTS, vector<unsigned>(0,0));
-  bool already_in_vector;
-
   // popolo il vettore involved_constraints, inseriamo tutti le constraints dei due round
+  st.involved_constraints.Clear();
   for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
   {
     // [m.r1]
-    involved_constraints[c_type] = in.slot_constraints[c_type][m.r1];
+    st.involved_constraints.Add(c_type, in.SlotConstraints(c_type, m.r1));
     // [m.r2]
-    for (unsigned int i = 0; i<in.slot_constraints[c_type][m.r2].size(); i++)
-    {
-      already_in_vector = false;
-      for(unsigned int j = 0; j<involved_constraints[c_type].size(); j++)
-      {
-        if(involved_constraints[c_type][j] == in.slot_constraints[c_type][m.r2][i])
-        {
-          already_in_vector = true;
-          break;
-        }
-      }
-      if(!already_in_vector)
-      involved_constraints[c_type].push_back(in.slot_constraints[c_type][m.r2][i]);
-    }
+    st.involved_constraints.Add(c_type, in.SlotConstraints(c_type, m.r2));
   }
 
   ExecuteMove(st, m);
 
-  st.UpdateSelectionedCostsConstraints(involved_constraints);
-  st.CalculateCostPhased();
+  st.UpdateSelectionedCostsConstraints(st.involved_constraints.Constraints());
+  st.UpdateCostPhased();
 
   st.UpdateMoveCounterAndBestSolution(st.ReturnTotalCost());
 
@@ -2485,3 +2477,10 @@ inline bool intersect(const std::vector<unsigned>& l1, const std::vector<unsigne
 	return true;
   return false;
 }
+
+template unsigned STT_CheckDeltaCosts(const STT_SwapHomesNeighborhoodExplorer& ne, STT_Solution& st, unsigned moves, ostream& os);
+template unsigned STT_CheckDeltaCosts(const STT_SwapTeamsNeighborhoodExplorer& ne, STT_Solution& st, unsigned moves, ostream& os);
+template unsigned STT_CheckDeltaCosts(const STT_SwapRoundsNeighborhoodExplorer& ne, STT_Solution& st, unsigned moves, ostream& os);
+template unsigned STT_CheckDeltaCosts(const STT_SwapMatchesNotPhasedNeighborhoodExplorer& ne, STT_Solution& st, unsigned moves, ostream& os);
+template unsigned STT_CheckDeltaCosts(const STT_SwapMatchesPhasedNeighborhoodExplorer& ne, STT_Solution& st, unsigned moves, ostream& os);
+template unsigned STT_CheckDeltaCosts(const STT_SwapMatchRoundNeighborhoodExplorer& ne, STT_Solution& st, unsigned moves, ostream& os);
@@ -8,8 +8,8 @@ class STT_SolutionManager
 : public SolutionManager<STT_Input, STT_Solution>
 {
 public:
-  STT_SolutionManager(const STT_Input & in, string name, bool mix_initial_phase = true, bool display_OF = false, bool vizing_greedy = false)
-     : SolutionManager<STT_Input, STT_Solution>::SolutionManager(in, name), vizing_greedy(vizing_greedy), mix_initial_phase(mix_initial_phase), display_OF(display_OF) {}
+  STT_SolutionManager(const STT_Input & in, STT_Random& rng, string name, bool mix_initial_phase = true, bool display_OF = false, bool vizing_greedy = false)
+     : SolutionManager<STT_Input, STT_Solution>::SolutionManager(in, name), rng(rng), vizing_greedy(vizing_greedy), mix_initial_phase(mix_initial_phase), display_OF(display_OF) {}
   void RandomState(STT_Solution& st);
   void GreedyState(STT_Solution& st);
   bool CheckConsistency(const STT_Solution& st) const;
@@ -17,6 +17,7 @@ public:
   bool OptimalStateReached(const STT_Solution& st) const override;
 
 private:
+  STT_Random& rng;
   bool vizing_greedy;
   bool mix_initial_phase;
   bool display_OF;
@@ -103,6 +104,77 @@ public:
     //void SetWeight(int new_weight) {weight = new_weight;}
 };
 
+/***************************************************************************
+ * Delta Cost Components (one class for all the moves):
+ ***************************************************************************/
+
+template <class Move>
+class STT_DeltaCostComponent : public DeltaCostComponent<STT_Input, STT_Solution, Move>
+{
+public:
+  STT_DeltaCostComponent(const STT_Input& in, CostComponent<STT_Input, STT_Solution>& cc, Constraints::ConstraintType c_type, string name)
+    : DeltaCostComponent<STT_Input, STT_Solution, Move>(in, cc, name), c_type(c_type) {}
+  int ComputeDeltaCost(const STT_Solution& st, const Move& m) const;
+private:
+  Constraints::ConstraintType c_type;
+};
+
+template <class Move>
+class STT_PhasedDeltaCostComponent : public DeltaCostComponent<STT_Input, STT_Solution, Move>
+{
+public:
+  STT_PhasedDeltaCostComponent(const STT_Input& in, PhasedCostComponent& cc, string name)
+    : DeltaCostComponent<STT_Input, STT_Solution, Move>(in, cc, name) {}
+  int ComputeDeltaCost(const STT_Solution& st, const Move& m) const;
+};
+
+// simulated annealing acceptance test with early abort: the random number is drawn before the evaluation, so that
+// the threshold -T*ln(u) is known and the delta cost (hard constraints first) is computed only until the move is surely
+// rejected; returns true iff m is accepted at the given temperature, and in that case delta is its exact delta cost
+// (evaluated is the number of constraints evaluated, as in CalculateDeltaCostBounded)
+template <class Move>
+bool STT_AnnealingAccepts(STT_Random& rng, const STT_Solution& st, const Move& m, double temperature, int& delta, unsigned& evaluated);
+
+// non-interactive check of the delta costs of ne: the given number of random moves are made on st, and for each the sum of
+// the delta costs of all the components, the bounded delta and the cost after MakeMove must match the recalculation
+// of the full cost; the mismatches are printed on os, and their number is returned
+template <class NE>
+unsigned STT_CheckDeltaCosts(const NE& ne, STT_Solution& st, unsigned moves, ostream& os);
+
+// the delta cost components of all the cost components of a stage, to be added to a neighborhood explorer for Move
+template <class Move>
+class STT_DeltaCostComponents
+{
+public:
+  STT_DeltaCostComponents(const STT_Input& in, string name, CA1CostComponent& ca1, CA2CostComponent& ca2, CA3CostComponent& ca3,
+                          CA4CostComponent& ca4, GA1CostComponent& ga1, BR1CostComponent& br1, BR2CostComponent& br2,
+                          FA2CostComponent& fa2, SE1CostComponent& se1, PhasedCostComponent& phs)
+    : in(in), ca1(in, ca1, CA1, "CA1_" + name), ca2(in, ca2, CA2, "CA2_" + name), ca3(in, ca3, CA3, "CA3_" + name),
+      ca4(in, ca4, CA4, "CA4_" + name), ga1(in, ga1, GA1, "GA1_" + name), br1(in, br1, BR1, "BR1_" + name),
+      br2(in, br2, BR2, "BR2_" + name), fa2(in, fa2, FA2, "FA2_" + name), se1(in, se1, SE1, "SE1_" + name),
+      phs(in, phs, "phased_" + name) {}
+  void AddTo(NeighborhoodExplorer<STT_Input, STT_Solution, Move>& ne)
+  {
+    ne.AddDeltaCostComponent(ca1);
+    ne.AddDeltaCostComponent(ca2);
+    ne.AddDeltaCostComponent(ca3);
+    ne.AddDeltaCostComponent(ca4);
+    ne.AddDeltaCostComponent(ga1);
+    ne.AddDeltaCostComponent(br1);
+    ne.AddDeltaCostComponent(br2);
+    ne.AddDeltaCostComponent(fa2);
+    ne.AddDeltaCostComponent(se1);
+    if(in.phased)
+    {
+      ne.AddDeltaCostComponent(phs);
+    }
+  }
+private:
+  const STT_Input& in;
+  STT_DeltaCostComponent<Move> ca1, ca2, ca3, ca4, ga1, br1, br2, fa2, se1;
+  STT_PhasedDeltaCostComponent<Move> phs;
+};
+
 /***************************************************************************
  * 1 STT_SwapHomes Neighborhood Explorer:
  ***************************************************************************/
@@ -111,7 +183,7 @@ class STT_SwapHomesNeighborhoodExplorer
   : public NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapHomes> 
 {
 public:
-  STT_SwapHomesNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm);
+  STT_SwapHomesNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng);
   void AnyRandomMove(const STT_Solution&, STT_SwapHomes&) const;
   void RandomMove(const STT_Solution&, STT_SwapHomes&) const;
   bool FeasibleMove(const STT_Solution&, const STT_SwapHomes&) const; 
@@ -119,6 +191,8 @@ public:
   void MakeMove(STT_Solution&,const STT_SwapHomes&) const; 
   void FirstMove(const STT_Solution&,STT_SwapHomes&) const;
   bool NextMove(const STT_Solution&,STT_SwapHomes&) const;   
+private:
+  STT_Random& rng;
 };
 
 /***************************************************************************
@@ -129,7 +203,7 @@ class STT_SwapTeamsNeighborhoodExplorer
   : public NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapTeams> 
 {
 public:
-  STT_SwapTeamsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm);
+  STT_SwapTeamsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng);
   void AnyRandomMove(const STT_Solution&, STT_SwapTeams&) const;
   void RandomMove(const STT_Solution&, STT_SwapTeams&) const;
   bool FeasibleMove(const STT_Solution&, const STT_SwapTeams&) const; 
@@ -137,6 +211,8 @@ public:
   void MakeMove(STT_Solution&,const STT_SwapTeams&) const; 
   void FirstMove(const STT_Solution&,STT_SwapTeams&) const;
   bool NextMove(const STT_Solution&,STT_SwapTeams&) const;   
+private:
+  STT_Random& rng;
 };
 
 
@@ -148,7 +224,7 @@ class STT_SwapRoundsNeighborhoodExplorer
   : public NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapRounds> 
 {
 public:
-  STT_SwapRoundsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm);
+  STT_SwapRoundsNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng);
   void AnyRandomMove(const STT_Solution&, STT_SwapRounds&) const;
   void RandomMove(const STT_Solution&, STT_SwapRounds&) const;
   bool FeasibleMove(const STT_Solution&, const STT_SwapRounds&) const; 
@@ -156,6 +232,8 @@ public:
   void MakeMove(STT_Solution&,const STT_SwapRounds&) const; 
   void FirstMove(const STT_Solution&,STT_SwapRounds&) const;
   bool NextMove(const STT_Solution&,STT_SwapRounds&) const;   
+private:
+  STT_Random& rng;
 };
 
 /***************************************************************************
@@ -166,10 +244,9 @@ class STT_SwapMatchesNotPhasedNeighborhoodExplorer
   : public NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchesNotPhased> 
 {
 public:
-  STT_SwapMatchesNotPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm);
+  STT_SwapMatchesNotPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng);
   void RandomMove(const STT_Solution&, STT_SwapMatchesNotPhased&) const;
   bool FeasibleMove(const STT_Solution&, const STT_SwapMatchesNotPhased&) const; 
-  void FastExecuteMove(STT_Solution&,const STT_SwapMatchesNotPhased&) const;  //used only in FeasibleMove
   void MakeMove(STT_Solution&,const STT_SwapMatchesNotPhased&) const; 
   void FirstMove(const STT_Solution&,STT_SwapMatchesNotPhased&) const;
   bool NextMove(const STT_Solution&,STT_SwapMatchesNotPhased&) const;   
@@ -178,6 +255,7 @@ public:
   void SetMaxChainLength(unsigned mml) { max_move_length = mml; }
   unsigned GetMaxMoveLength() const { return max_move_length; }
 private:
+  STT_Random& rng;
   bool AnyNextMove(const STT_Solution&,STT_SwapMatchesNotPhased&) const;  
   void AnyRandomMove(const STT_Solution&,STT_SwapMatchesNotPhased&) const;  
   unsigned max_move_length;
@@ -192,10 +270,9 @@ class STT_SwapMatchesPhasedNeighborhoodExplorer
   : public NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchesPhased> 
 {
 public:
-  STT_SwapMatchesPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm);
+  STT_SwapMatchesPhasedNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng);
   void RandomMove(const STT_Solution&, STT_SwapMatchesPhased&) const;
   bool FeasibleMove(const STT_Solution&, const STT_SwapMatchesPhased&) const; 
-  void FastExecuteMove(STT_Solution&,const STT_SwapMatchesPhased&) const;  //used only in FeasibleMove
   void MakeMove(STT_Solution&,const STT_SwapMatchesPhased&) const; 
   void FirstMove(const STT_Solution&,STT_SwapMatchesPhased&) const;
   bool NextMove(const STT_Solution&,STT_SwapMatchesPhased&) const;  
@@ -204,6 +281,7 @@ public:
   void SetMaxChainLength(unsigned mml) { max_move_length = mml; }
   unsigned GetMaxMoveLength() const { return max_move_length; }
 private:
+  STT_Random& rng;
   bool AnyNextMove(const STT_Solution&,STT_SwapMatchesPhased&) const;  
   void AnyRandomMove(const STT_Solution&,STT_SwapMatchesPhased&) const;  
   unsigned max_move_length;
@@ -218,7 +296,7 @@ class STT_SwapMatchRoundNeighborhoodExplorer
   : public NeighborhoodExplorer<STT_Input,STT_Solution,STT_SwapMatchRound> 
 {
 public:
-  STT_SwapMatchRoundNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm);
+  STT_SwapMatchRoundNeighborhoodExplorer(const STT_Input& in, SolutionManager<STT_Input, STT_Solution>& sm, STT_Random& rng);
   void RandomMove(const STT_Solution&, STT_SwapMatchRound&) const;
   bool FeasibleMove(const STT_Solution&, const STT_SwapMatchRound&) const; 
   void ExecuteMove(STT_Solution&,const STT_SwapMatchRound&) const; 
@@ -229,6 +307,7 @@ public:
   void SetMaxChainLength(unsigned mml) { max_move_length = mml; }
   unsigned GetMaxMoveLength() const { return max_move_length; }
 private:
+  STT_Random& rng;
   bool AnyNextMove(const STT_Solution&,STT_SwapMatchRound&) const;  
   void AnyRandomMove(const STT_Solution&,STT_SwapMatchRound&) const;  
   unsigned max_move_length;
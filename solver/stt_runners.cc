@@ -0,0 +1,446 @@
+#include "stt_runners.hh"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+/***************************************************************************
+ * METHODS FOR STT_AnnealingChain:
+ ***************************************************************************/
+
+STT_AnnealingChain::STT_AnnealingChain(const STT_Input& in, STT_SolutionManager& sm, const array<double, 6>& rates, const STT_Solution& st, unsigned seed, bool adaptive)
+  : sm(sm), rng(seed), swap_homes_nh(in, sm, rng), swap_teams_nh(in, sm, rng), swap_rounds_nh(in, sm, rng),
+    swap_matches_notphased_nh(in, sm, rng), swap_matches_phased_nh(in, sm, rng), swap_match_round_nh(in, sm, rng),
+    rates(rates), adaptive(adaptive), probabilities(rates), window_gain{}, window_work{},
+    current(st), best(st), current_cost(current.ReturnTotalCost()), best_cost(current_cost), temperature(0.0), oscillating(false), evaluations(0), last_improvement(0), accepted(0),
+    optimal(sm.OptimalStateReached(best))
+{
+}
+
+unsigned long int STT_AnnealingChain::Anneal(unsigned long int evaluations, unsigned long int max_accepted)
+{
+  // as in the EasyLocal runners, a draw from an empty neighborhood is not an evaluation: another neighborhood is drawn
+  unsigned long int e = 0, accepted_before = accepted;
+  for (unsigned empty_draws = 0; e < evaluations && accepted - accepted_before < max_accepted && !optimal;)
+  {
+    unsigned nh = SampleNeighborhood();
+    int gain;
+    unsigned work;
+    bool drawn;
+    switch (nh)
+    {
+      case 0: drawn = Step(swap_homes_nh, gain, work); break;
+      case 1: drawn = Step(swap_teams_nh, gain, work); break;
+      case 2: drawn = Step(swap_rounds_nh, gain, work); break;
+      case 3: drawn = Step(swap_matches_notphased_nh, gain, work); break;
+      case 4: drawn = Step(swap_matches_phased_nh, gain, work); break;
+      default: drawn = Step(swap_match_round_nh, gain, work); break;
+    }
+    if (!drawn)
+    {
+      if (++empty_draws == max_empty_draws)
+        break;
+      continue;
+    }
+    empty_draws = 0;
+    e++;
+    if (!adaptive)
+      continue;
+    window[nh].emplace_back(gain, work);
+    window_gain[nh] += gain;
+    window_work[nh] += work;
+    if (window[nh].size() > window_size)
+    {
+      window_gain[nh] -= window[nh].front().first;
+      window_work[nh] -= window[nh].front().second;
+      window[nh].pop_front();
+    }
+    if (e % update_interval == 0)
+      UpdateProbabilities();
+  }
+  return e;
+}
+
+unsigned STT_AnnealingChain::SampleNeighborhood()
+{
+  // the rounding leftovers of p go to the last neighborhood with a positive probability, so that the ones with
+  // probability 0 are never sampled
+  double p = rng.Uniform<double>(0.0, accumulate(begin(probabilities), end(probabilities), 0.0));
+  unsigned last = 0;
+  for (unsigned nh = 0; nh < probabilities.size(); nh++)
+    if (probabilities[nh] > 0.0)
+    {
+      if (p < probabilities[nh])
+        return nh;
+      p -= probabilities[nh];
+      last = nh;
+    }
+  return last;
+}
+
+template <class NE>
+bool STT_AnnealingChain::Step(const NE& ne, int& gain, unsigned& work)
+{
+  typename NE::MoveType m;
+  int delta;
+  unsigned evaluated;
+  try
+  {
+    ne.RandomMove(current, m);
+  }
+  catch (EmptyNeighborhood&)
+  {
+    return false;
+  }
+  evaluations++;
+  gain = 0;
+  bool accepts = STT_AnnealingAccepts(rng, current, m, temperature, delta, evaluated);
+  work = evaluated + 1; //a move that involves no constraint still costs its draw
+  if (!accepts)
+    return true;
+  accepted++;
+  // the gain is measured with the weights of the input, which (unlike the ones of current) do not change with the oscillation
+  int cost_before = oscillating ? ReferenceCost() : current_cost;
+  ne.MakeMove(current, m);
+  current_cost = current.ReturnTotalCost();
+  int cost = oscillating ? ReferenceCost() : current_cost;
+  if (cost < best_cost)
+  {
+    best = current;
+    best_cost = cost;
+    last_improvement = evaluations;
+    optimal = sm.OptimalStateReached(best);
+  }
+  gain = max(cost_before - cost, 0);
+  return true;
+}
+
+void STT_AnnealingChain::Restart(unsigned perturbation_moves)
+{
+  int hard_weight = current.stt_hard_weight;
+  array<int, N_CONSTRAINTS> hard_weight_factors = current.hard_weight_factors;
+  current = best;
+  current.stt_hard_weight = hard_weight;
+  current.hard_weight_factors = hard_weight_factors;
+  current.ApplyWeights();
+  for (unsigned i = 0; i < perturbation_moves; i++)
+    switch (SampleNeighborhood())
+    {
+      case 0: Perturb(swap_homes_nh); break;
+      case 1: Perturb(swap_teams_nh); break;
+      case 2: Perturb(swap_rounds_nh); break;
+      case 3: Perturb(swap_matches_notphased_nh); break;
+      case 4: Perturb(swap_matches_phased_nh); break;
+      default: Perturb(swap_match_round_nh); break;
+    }
+  current_cost = current.ReturnTotalCost();
+}
+
+template <class NE>
+void STT_AnnealingChain::Perturb(const NE& ne)
+{
+  typename NE::MoveType m;
+  try
+  {
+    ne.RandomMove(current, m);
+  }
+  catch (EmptyNeighborhood&)
+  {
+    return;
+  }
+  ne.MakeMove(current, m);
+}
+
+int STT_AnnealingChain::ReferenceCost() const
+{
+  static const array<int, N_CONSTRAINTS> input_factors = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+  return current.cost_phased + current.WeighComponents(current.in.initial_stt_hard_weight, input_factors);
+}
+
+void STT_AnnealingChain::UpdateProbabilities()
+{
+  // the neighborhoods with rate 0 are never sampled; without any decrease of the cost in the windows the
+  // probabilities are the static rates
+  double total_rate = accumulate(begin(rates), end(rates), 0.0), total_reward = 0.0;
+  array<double, 6> reward;
+  for (unsigned nh = 0; nh < rates.size(); nh++)
+  {
+    reward[nh] = rates[nh] > 0.0 && window_work[nh] > 0.0 ? window_gain[nh] / window_work[nh] : 0.0;
+    total_reward += reward[nh];
+  }
+  for (unsigned nh = 0; nh < rates.size(); nh++)
+    if (total_reward > 0.0)
+      probabilities[nh] = exploration * rates[nh] / total_rate + (1.0 - exploration) * reward[nh] / total_reward;
+    else
+      probabilities[nh] = rates[nh] / total_rate;
+}
+
+/***************************************************************************
+ * METHODS FOR STT_Runner:
+ ***************************************************************************/
+
+SolverResult<STT_Input, STT_Solution> STT_Runner::Solve()
+{
+  STT_Solution st(in);
+  if (random_state)
+    sm.RandomState(st);
+  else
+    sm.GreedyState(st);
+  return Resolve(st);
+}
+
+/***************************************************************************
+ * METHODS FOR STT_ParallelTempering:
+ ***************************************************************************/
+
+STT_ParallelTempering::STT_ParallelTempering(const STT_Input& in, STT_SolutionManager& sm, STT_Random& rng, const array<double, 6>& rates, unsigned replicas, bool random_state)
+  : STT_Runner(in, sm, rng, rates, random_state), replicas(max(replicas, 1u)), start_temperature(1.0), min_temperature(1.0), time_limit(-1.0),
+    max_evaluations(0), swap_interval(1), swaps(0), swap_attempts(0)
+{
+}
+
+void STT_ParallelTempering::SetParameters(double start_temperature, double min_temperature, unsigned long int max_evaluations, unsigned long int swap_interval)
+{
+  this->start_temperature = start_temperature;
+  this->min_temperature = min_temperature;
+  this->max_evaluations = max_evaluations;
+  this->swap_interval = max(swap_interval, 1ul);
+}
+
+SolverResult<STT_Input, STT_Solution> STT_ParallelTempering::Resolve(const STT_Solution& initial_solution)
+{
+  auto start = chrono::steady_clock::now();
+  auto elapsed = [&start]() { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+  // rs[k] is the replica at the k-th temperature (from the coldest): an exchange swaps the replicas and their
+  // temperatures, so that the states move between the temperatures together with their generators
+  vector<unique_ptr<STT_AnnealingChain>> rs;
+  for (unsigned k = 0; k < replicas; k++)
+  {
+    rs.push_back(make_unique<STT_AnnealingChain>(in, sm, rates, initial_solution, rng.Uniform<unsigned>(0, numeric_limits<unsigned>::max()), adaptive_rates));
+    rs[k]->temperature = replicas == 1 ? start_temperature : min_temperature * pow(start_temperature / min_temperature, static_cast<double>(k) / (replicas - 1));
+  }
+  swaps = 0;
+  swap_attempts = 0;
+
+  // the replicas are annealed by persistent workers, the k-th of which anneals rs[k] in each round: the calling thread
+  // starts a round by increasing rounds_started, and makes the exchanges once all the workers have finished it; the
+  // first exception of a worker ends the search after its round, and it is rethrown once the workers have been joined
+  mutex round_mutex;
+  condition_variable round_started, round_finished;
+  unsigned long int rounds_started = 0, round_evaluations = 0;
+  unsigned running = 0;
+  bool stop = false;
+  exception_ptr failure;
+  vector<thread> workers;
+  for (unsigned k = 0; k < replicas; k++)
+    workers.emplace_back([&, k] {
+      for (unsigned long int rounds_done = 0;; rounds_done++)
+      {
+        STT_AnnealingChain* r;
+        unsigned long int evaluations;
+        {
+          unique_lock<mutex> lock(round_mutex);
+          round_started.wait(lock, [&] { return stop || rounds_started > rounds_done; });
+          if (stop)
+            return;
+          r = rs[k].get();
+          evaluations = round_evaluations;
+        }
+        exception_ptr e;
+        try
+        {
+          r->Anneal(evaluations);
+        }
+        catch (...)
+        {
+          e = current_exception();
+        }
+        lock_guard<mutex> lock(round_mutex);
+        if (e && !failure)
+          failure = e;
+        if (--running == 0)
+          round_finished.notify_one();
+      }
+    });
+
+  for (unsigned long int done = 0, round = 0; time_limit >= 0.0 ? elapsed() < time_limit : done < max_evaluations; done += swap_interval, round++)
+  {
+    {
+      unique_lock<mutex> lock(round_mutex);
+      round_evaluations = time_limit >= 0.0 ? swap_interval : min(swap_interval, max_evaluations - done);
+      running = replicas;
+      rounds_started++;
+      round_started.notify_all();
+      round_finished.wait(lock, [&running] { return running == 0; });
+    }
+    if (failure || any_of(begin(rs), end(rs), [](const unique_ptr<STT_AnnealingChain>& r) { return r->optimal; }))
+      break;
+
+    // exchanges between adjacent temperatures, alternating the even and the odd pairs at each round
+    for (unsigned k = round % 2; k + 1 < replicas; k += 2)
+    {
+      STT_AnnealingChain& cold = *rs[k];
+      STT_AnnealingChain& hot = *rs[k + 1];
+      double exponent = (1.0 / cold.temperature - 1.0 / hot.temperature) * (cold.current_cost - hot.current_cost);
+      swap_attempts++;
+      if (exponent >= 0.0 || rng.Uniform<double>(0.0, 1.0) < exp(exponent))
+      {
+        swap(cold.temperature, hot.temperature);
+        swap(rs[k], rs[k + 1]);
+        swaps++;
+      }
+    }
+  }
+  {
+    lock_guard<mutex> lock(round_mutex);
+    stop = true;
+  }
+  round_started.notify_all();
+  for (auto& w : workers)
+    w.join();
+  if (failure)
+    rethrow_exception(failure);
+
+  const STT_AnnealingChain& best = **min_element(begin(rs), end(rs), [](const unique_ptr<STT_AnnealingChain>& r1, const unique_ptr<STT_AnnealingChain>& r2) { return r1->best_cost < r2->best_cost; });
+  SolverResult<STT_Input, STT_Solution> result(best.best);
+  result.running_time = elapsed();
+  return result;
+}
+
+/***************************************************************************
+ * METHODS FOR STT_SimulatedAnnealing:
+ ***************************************************************************/
+
+STT_SimulatedAnnealing::STT_SimulatedAnnealing(const STT_Input& in, STT_SolutionManager& sm, STT_Random& rng, const array<double, 6>& rates, bool random_state)
+  : STT_Runner(in, sm, rng, rates, random_state), start_temperature(1.0), min_temperature(1.0), time_limit(-1.0), max_evaluations(0),
+    cooling_rate(0.0), neighbors_accepted_ratio(1.0), oscillation_interval(0), feasible_window(1), max_factor(1), stagnation_evaluations(0), restart(false), perturbation_moves(0), max_periods(0)
+{
+}
+
+void STT_SimulatedAnnealing::SetParameters(double start_temperature, double min_temperature, unsigned long int max_evaluations)
+{
+  this->start_temperature = start_temperature;
+  this->min_temperature = min_temperature;
+  this->max_evaluations = max_evaluations;
+}
+
+void STT_SimulatedAnnealing::SetCooling(double cooling_rate, double neighbors_accepted_ratio)
+{
+  this->cooling_rate = cooling_rate;
+  this->neighbors_accepted_ratio = neighbors_accepted_ratio;
+}
+
+void STT_SimulatedAnnealing::SetOscillation(unsigned long int oscillation_interval, unsigned feasible_window, int max_factor)
+{
+  this->oscillation_interval = oscillation_interval;
+  this->feasible_window = max(feasible_window, 1u);
+  this->max_factor = max(max_factor, 1);
+}
+
+void STT_SimulatedAnnealing::SetStagnation(unsigned long int stagnation_evaluations, bool restart, unsigned perturbation_moves, unsigned max_periods)
+{
+  this->stagnation_evaluations = stagnation_evaluations;
+  this->restart = restart;
+  this->perturbation_moves = perturbation_moves;
+  this->max_periods = max_periods;
+}
+
+SolverResult<STT_Input, STT_Solution> STT_SimulatedAnnealing::Resolve(const STT_Solution& initial_solution)
+{
+  auto start = chrono::steady_clock::now();
+  double elapsed = 0.0;
+  unsigned feasible_checks = 0;
+  double rewind = 0.0; //part of the schedule undone by the reheats
+  unsigned long int last_reaction = 0; //evaluation of the last reheat or restart
+  unsigned periods = 0; //stagnation periods in a row without improvements
+  STT_AnnealingChain chain(in, sm, rates, initial_solution, rng.Uniform<unsigned>(0, numeric_limits<unsigned>::max()), adaptive_rates);
+  if (oscillation_interval > 0)
+  {
+    // the oscillation starts with the factors at 1 and the highest global weight, the best state is evaluated with the weights of the input
+    chain.oscillating = true;
+    chain.best_cost = chain.ReferenceCost();
+    chain.current.stt_hard_weight = max(in.initial_stt_hard_weight / max_factor, 1);
+    chain.current.hard_weight_factors.fill(1);
+    chain.current_cost = chain.current.ApplyWeights();
+  }
+  // stepwise schedule: each step lowers the temperature by cooling_rate, so the progress of the schedule is step/steps
+  bool stepwise = time_limit < 0.0 && cooling_rate > 0.0 && cooling_rate < 1.0 && min_temperature < start_temperature;
+  double steps = stepwise ? log(min_temperature / start_temperature) / log(cooling_rate) : 1.0; //number of temperatures
+  unsigned long int max_sampled = max(static_cast<unsigned long int>(max_evaluations / max(steps, 1.0)), 1ul);
+  unsigned long int max_accepted = max(static_cast<unsigned long int>(neighbors_accepted_ratio * max_sampled), 1ul);
+  unsigned long int step = 0, sampled = 0, accepted = 0; //step of the temperature, and evaluations and accepted moves at it
+  for (unsigned long int done = 0; (time_limit >= 0.0 ? elapsed < time_limit : done < max_evaluations) && !chain.optimal;)
+  {
+    double progress = time_limit >= 0.0 ? elapsed / time_limit : stepwise ? step / steps : static_cast<double>(done) / max_evaluations;
+    chain.temperature = start_temperature * pow(min_temperature / start_temperature, progress - rewind);
+    unsigned long int evaluations = time_limit >= 0.0 ? evaluations_per_check : min(evaluations_per_check, max_evaluations - done);
+    if (stepwise)
+      evaluations = min(evaluations, max_sampled - sampled);
+    // with the stepwise schedule, the temperature is lowered right at the evaluation that reaches max_sampled or max_accepted
+    unsigned long int accepted_before = chain.accepted, accepted_left = stepwise ? max_accepted - accepted : numeric_limits<unsigned long int>::max();
+    unsigned long int evaluations_done = chain.Anneal(evaluations, accepted_left);
+    bool stopped = evaluations_done < evaluations && chain.accepted - accepted_before < accepted_left; //empty neighborhoods, or best optimal
+    if (oscillation_interval > 0 && done / oscillation_interval != (done + evaluations_done) / oscillation_interval)
+      Oscillate(chain, feasible_checks);
+    done += evaluations_done;
+    if (stopped)
+      break;
+    if (stepwise)
+    {
+      sampled += evaluations_done;
+      accepted += chain.accepted - accepted_before;
+      if (sampled >= max_sampled || accepted >= max_accepted)
+      {
+        step++;
+        sampled = 0;
+        accepted = 0;
+      }
+    }
+    elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (stagnation_evaluations > 0 && chain.evaluations - max(chain.last_improvement, last_reaction) >= stagnation_evaluations)
+    {
+      periods = chain.last_improvement > last_reaction ? 1 : periods + 1;
+      last_reaction = chain.evaluations;
+      if (max_periods > 0 && periods >= max_periods)
+        break;
+      if (restart)
+        chain.Restart(perturbation_moves);
+      else
+        rewind += (progress - rewind) / 2.0;
+    }
+  }
+  if (oscillation_interval > 0)
+  {
+    chain.best.stt_hard_weight = in.initial_stt_hard_weight;
+    chain.best.hard_weight_factors.fill(1);
+    chain.best.ApplyWeights();
+  }
+  SolverResult<STT_Input, STT_Solution> result(chain.best);
+  result.running_time = elapsed;
+  return result;
+}
+
+void STT_SimulatedAnnealing::Oscillate(STT_AnnealingChain& chain, unsigned& feasible_checks) const
+{
+  STT_Solution& st = chain.current;
+  if (st.total_cost_components_hard > 0 || st.cost_phased > 0) //the phased requirement is hard as well
+  {
+    feasible_checks = 0;
+    st.stt_hard_weight = min(2 * st.stt_hard_weight, max(in.initial_stt_hard_weight / max_factor, 1));
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+      if (st.violations_hard[c_type] > 0)
+        st.hard_weight_factors[c_type] = min(2 * st.hard_weight_factors[c_type], max_factor);
+  }
+  else if (++feasible_checks >= feasible_window)
+  {
+    feasible_checks = 0;
+    st.stt_hard_weight = max(st.stt_hard_weight / 2, 1);
+    for (unsigned int c_type = CA1; c_type <= SE1; c_type++)
+      st.hard_weight_factors[c_type] = max(st.hard_weight_factors[c_type] / 2, 1);
+  }
+  chain.current_cost = st.ApplyWeights();
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "stt_helpers.hh"
+#include <array>
+#include <deque>
+#include <limits>
+#include <memory>
+
+/***************************************************************************
+ * Annealing chain:
+ * a state annealed over the six neighborhoods of the composite explorer
+ * (with its rates), with its own generator and explorers, so that chains
+ * in different threads share no state.
+ * With adaptive rates, the neighborhoods are sampled as in a sliding window
+ * bandit: each one proportionally to the decrease of the reference cost it
+ * gave per constraint evaluated in its last window_size moves (a measure of
+ * the work that, unlike time, does not depend on the machine, so the runs
+ * stay reproducible from the seed), mixed with its static rate
+ ***************************************************************************/
+
+class STT_AnnealingChain
+{
+public:
+  STT_AnnealingChain(const STT_Input& in, STT_SolutionManager& sm, const array<double, 6>& rates, const STT_Solution& st, unsigned seed, bool adaptive = false);
+  unsigned long int Anneal(unsigned long int evaluations, unsigned long int max_accepted = numeric_limits<unsigned long int>::max()); //at the current temperature, until evaluations are done or max_accepted moves are accepted; returns the evaluations done (fewer only then, or if the neighborhoods are empty or best is optimal)
+  const array<double, 6>& Probabilities() const { return probabilities; }
+  int ReferenceCost() const; //cost of current with the weights of the input (current_cost, unless oscillating)
+  void Restart(unsigned perturbation_moves); //current becomes best (keeping its weights), perturbed by random moves
+private:
+  static constexpr unsigned window_size = 1000; //moves of each neighborhood in the window
+  static constexpr unsigned update_interval = 100; //evaluations between two updates of the probabilities
+  static constexpr double exploration = 0.1; //weight of the static rates in the probabilities
+  static constexpr unsigned max_empty_draws = 1000; //draws in a row from empty neighborhoods after which they are considered all empty
+  template <class NE>
+  bool Step(const NE& ne, int& gain, unsigned& work); //false if the neighborhood is empty, otherwise gain is the decrease of the reference cost and work the constraints evaluated (at least 1)
+  template <class NE>
+  void Perturb(const NE& ne); //makes a random move, whatever its cost
+  unsigned SampleNeighborhood();
+  void UpdateProbabilities();
+  STT_SolutionManager& sm;
+  STT_Random rng;
+  STT_SwapHomesNeighborhoodExplorer swap_homes_nh;
+  STT_SwapTeamsNeighborhoodExplorer swap_teams_nh;
+  STT_SwapRoundsNeighborhoodExplorer swap_rounds_nh;
+  STT_SwapMatchesNotPhasedNeighborhoodExplorer swap_matches_notphased_nh;
+  STT_SwapMatchesPhasedNeighborhoodExplorer swap_matches_phased_nh;
+  STT_SwapMatchRoundNeighborhoodExplorer swap_match_round_nh;
+  const array<double, 6>& rates;
+  bool adaptive;
+  array<double, 6> probabilities;
+  array<deque<pair<int, unsigned>>, 6> window; //decrease of the reference cost and constraints evaluated of the last moves
+  array<double, 6> window_gain, window_work;
+public:
+  STT_Solution current, best;
+  int current_cost, best_cost; //best_cost is the reference cost of best
+  double temperature;
+  bool oscillating; //the hard weights of current are changed by the runner
+  unsigned long int evaluations, last_improvement; //evaluations done, and done when best was last improved
+  unsigned long int accepted; //moves accepted
+  bool optimal; //best is an optimal state of sm (then Anneal does nothing)
+};
+
+/***************************************************************************
+ * Runners of this module: as SimpleLocalSearch, Solve starts from a random
+ * (or greedy) state of the solution manager
+ ***************************************************************************/
+
+class STT_Runner
+{
+public:
+  STT_Runner(const STT_Input& in, STT_SolutionManager& sm, STT_Random& rng, const array<double, 6>& rates, bool random_state)
+    : in(in), sm(sm), rng(rng), rates(rates), random_state(random_state), adaptive_rates(false) {}
+  virtual ~STT_Runner() {}
+  SolverResult<STT_Input, STT_Solution> Solve();
+  virtual SolverResult<STT_Input, STT_Solution> Resolve(const STT_Solution& initial_solution) = 0;
+  void SetAdaptiveRates(bool adaptive_rates) { this->adaptive_rates = adaptive_rates; }
+protected:
+  const STT_Input& in;
+  STT_SolutionManager& sm;
+  STT_Random& rng; //seeds of the chains (used only by the calling thread)
+  array<double, 6> rates;
+  bool random_state;
+  bool adaptive_rates;
+};
+
+/***************************************************************************
+ * Parallel Tempering (replica exchange):
+ * the replicas are chains at fixed temperatures, geometrically spaced
+ * between min_temperature and start_temperature, each in its own thread
+ * (kept for the whole search and synchronised at the end of each round);
+ * every swap_interval evaluations the states at adjacent temperatures are
+ * exchanged with the Metropolis criterion
+ ***************************************************************************/
+
+class STT_ParallelTempering : public STT_Runner
+{
+public:
+  STT_ParallelTempering(const STT_Input& in, STT_SolutionManager& sm, STT_Random& rng, const array<double, 6>& rates, unsigned replicas, bool random_state = true);
+  void SetParameters(double start_temperature, double min_temperature, unsigned long int max_evaluations, unsigned long int swap_interval); //max_evaluations is per replica
+  void SetTimeLimit(double time_limit) { this->time_limit = time_limit; } //in seconds, it replaces max_evaluations if not negative
+  SolverResult<STT_Input, STT_Solution> Resolve(const STT_Solution& initial_solution) override;
+  unsigned long int Swaps() const { return swaps; }
+  unsigned long int SwapAttempts() const { return swap_attempts; }
+private:
+  unsigned replicas;
+  double start_temperature, min_temperature, time_limit;
+  unsigned long int max_evaluations, swap_interval;
+  unsigned long int swaps, swap_attempts;
+};
+
+/***************************************************************************
+ * Simulated Annealing:
+ * a single chain whose temperature decreases geometrically from
+ * start_temperature to min_temperature with the fraction of max_evaluations
+ * done or, with a time limit, with the fraction of the time elapsed, so that
+ * the whole schedule fits the time limit whatever the speed of the evaluations.
+ * Without a time limit and with a cooling rate, the temperature follows the
+ * schedule of SimulatedAnnealingEvaluationBased instead: it is multiplied by
+ * cooling_rate after max_evaluations/(number of temperatures) evaluations, or
+ * right at the evaluation at which neighbors_accepted_ratio of them have been
+ * accepted (draws from empty neighborhoods are not evaluations).
+ * With a strategic oscillation, every oscillation_interval evaluations the
+ * hard weights of the current state are changed: while hard constraints (or
+ * the phased requirement) are violated, the global weight and the factors of
+ * the violated types double, and once the state has been feasible for
+ * feasible_window checks they are halved. The global weight ranges in [1, initial_stt_hard_weight/max_factor]
+ * and the factors in [1, max_factor], so the weights never exceed the ones of
+ * the input, which are the ones used for the best state.
+ * With a stagnation control, after stagnation_evaluations evaluations
+ * without improvements of the best state the search is either reheated (the
+ * temperature goes back to the one of half of the schedule done so far) or
+ * restarted from the best state perturbed by perturbation_moves random moves;
+ * after max_periods such periods in a row without improvements the search
+ * stops (a heuristic cutoff, to be tuned with the instances)
+ ***************************************************************************/
+
+class STT_SimulatedAnnealing : public STT_Runner
+{
+public:
+  STT_SimulatedAnnealing(const STT_Input& in, STT_SolutionManager& sm, STT_Random& rng, const array<double, 6>& rates, bool random_state = true);
+  void SetParameters(double start_temperature, double min_temperature, unsigned long int max_evaluations);
+  void SetTimeLimit(double time_limit) { this->time_limit = time_limit; } //in seconds, it replaces max_evaluations if not negative
+  void SetCooling(double cooling_rate, double neighbors_accepted_ratio); //cooling_rate = 0 for the continuous schedule
+  void SetOscillation(unsigned long int oscillation_interval, unsigned feasible_window, int max_factor); //oscillation_interval = 0 for no oscillation
+  void SetStagnation(unsigned long int stagnation_evaluations, bool restart, unsigned perturbation_moves, unsigned max_periods); //stagnation_evaluations = 0 for no control, max_periods = 0 for no stop
+  SolverResult<STT_Input, STT_Solution> Resolve(const STT_Solution& initial_solution) override;
+private:
+  static constexpr unsigned long int evaluations_per_check = 100; //evaluations between two updates of the temperature
+  void Oscillate(STT_AnnealingChain& chain, unsigned& feasible_checks) const;
+  double start_temperature, min_temperature, time_limit;
+  unsigned long int max_evaluations;
+  double cooling_rate, neighbors_accepted_ratio;
+  unsigned long int oscillation_interval;
+  unsigned feasible_window;
+  int max_factor;
+  unsigned long int stagnation_evaluations;
+  bool restart;
+  unsigned perturbation_moves, max_periods;
+};